@@ -18,12 +18,14 @@ public:
     void setNewConnectionCallback(const NewConnectionCallback& cb){NewConnectionCallback_ = cb;}
     // 判断是否在监听
     bool listenning() const {return listenning_;}
+    // 获取acceptChannel_所属的loop
+    EventLoop* getLoop() const {return loop_;}
     //监听本地端口
     void listen();
 private:
     void handleRead(); // 处理新用户的连接事件
 
-    EventLoop* loop_; // Acceptor用的就是用户定义的那个baseLoop 也称作mainLoop
+    EventLoop* loop_; // 默认是用户定义的那个baseLoop 也称作mainLoop; TcpServer::kReusePortPerLoop模式下是各个subloop
     Socket acceptSocket_; // 专门用于接收新连接的socket
     Channel acceptChannel_;//专门用于监听新连接的channel
     NewConnectionCallback NewConnectionCallback_;//新连接的回调函数
@@ -5,15 +5,40 @@
 #include "FixedBuffer.h"
 #include "LogStream.h"
 #include "LogFile.h"
+#include "StagingRing.h"
+#include "LogRing.h"
+#include "LogCompressor.h"
 
 #include<vector>
 #include<memory>
 #include<mutex>
 #include <condition_variable>
 
-// 实现将前端缓冲区里的日志写入硬盘存储
+/**
+ * 实现将前端缓冲区里的日志写入硬盘存储
+ *
+ * 默认所有前端线程在mutex_保护下写同一个currentBuffer_.
+ * setThreadStaging打开后每个线程写自己的StagingRing(无锁SPSC), 后端每轮把各环的记录按时间戳归并后写盘;
+ * 某个环满了或单条日志太大时, 这一条退回走共享缓冲区
+ *
+ * 共享缓冲区排队的LargeBuffer个数有上限, 写满时按OverflowPolicy处理:
+ * 阻塞等后端、丢弃新日志、丢弃最早排队的缓冲或按比例采样, 丢弃的条数定期以一条WARN日志记录下来
+ *
+ * 后端每轮把取到的全部缓冲用LogFile::appendv一次writev写入(默认不经过stdio), 落盘策略见setSyncPolicy
+ *
+ * setCompression/setRetentionBytes打开后 滚动出来的文件交给后台的LogCompressor压缩和清理
+ *
+ * setCrashRing设置后 每条日志在进入缓冲之前先拷贝进LogRing, 崩溃时还没写盘的日志可以从环文件取回
+ **/
 class AsyncLogging{
 public:
+    enum OverflowPolicy{
+        kBlock,      // 前端等待后端腾出空间
+        kDropNewest, // 丢弃新来的日志
+        kDropOldest, // 丢弃最早排队的缓冲 新日志照常写入
+        kSample,     // 排队超过上限一半时只保留每sampleRate条中的一条 到上限后丢弃新日志
+    };
+
     AsyncLogging(const std::string& basename, off_t rollSize,int flushInterval=3);
     ~AsyncLogging(){
         if(running_) stop();
@@ -21,12 +46,50 @@ public:
     // 前端调用append写入日志
     void append(const char* logline,int len);
     void start(){
+        if(compressLevel_ > 0 || retainBytes_ > 0){
+            compressor_.reset(new LogCompressor(basename_, compressLevel_, retainBytes_));
+            compressor_->start();
+        }
         running_ = true;
         thread_.start();
     }
     void stop(){
         running_ = false;
-        cond_.notify_one();
+        {
+            std::lock_guard<std::mutex> lg(mutex_);
+            cond_.notify_one();
+            spaceCond_.notify_all();
+        }
+        thread_.join(); // 等后端把剩下的日志写完
+        if(compressor_) compressor_->stop();
+    }
+    // 每个线程的暂存环大小 0表示关闭(默认) 需要在start()之前设置
+    void setThreadStaging(size_t bytesPerThread){stagingBytes_ = bytesPerThread;}
+    // 每条日志同时写入ring(由调用者持有) nullptr表示关闭 需要在start()之前设置
+    void setCrashRing(LogRing* ring){crashRing_ = ring;}
+    // 后端直接对fd写 默认打开 需要在start()之前设置
+    void setDirectWrite(bool on){directWrite_ = on;}
+    // fdatasync策略 见LogFile::SyncPolicy 默认kSyncNone 需要在start()之前设置
+    void setSyncPolicy(LogFile::SyncPolicy policy, off_t bytes = 0){
+        syncPolicy_ = policy;
+        syncBytes_ = bytes;
+    }
+    // 滚动后丢掉旧日志文件的页缓存 默认关闭 需要在start()之前设置
+    void setDropRolledPages(bool on){dropRolledPages_ = on;}
+    // 滚动出来的文件用gzip压缩 level为1~9 0表示不压缩(默认) 需要在start()之前设置
+    void setCompression(int level){compressLevel_ = level;}
+    // 日志文件(含压缩后的)总大小上限 超过时删除最旧的 0表示不限制(默认) 需要在start()之前设置
+    void setRetentionBytes(off_t bytes){retainBytes_ = bytes;}
+    // 排队等待写盘的缓冲写满后的处理方式 默认kDropOldest
+    void setOverflowPolicy(OverflowPolicy policy, int sampleRate = 10){
+        std::lock_guard<std::mutex> lg(mutex_);
+        overflowPolicy_ = policy;
+        sampleRate_ = sampleRate > 0 ? sampleRate : 1;
+    }
+    // 最多排队多少个LargeBuffer(每个4MB) 默认25 0表示不限制
+    void setMaxQueuedBuffers(size_t n){
+        std::lock_guard<std::mutex> lg(mutex_);
+        maxQueuedBuffers_ = n;
     }
 private:
     using LargeBuffer = FixedBuffer<kLargeBufferSize>;
@@ -34,7 +97,22 @@ private:
     // BufferVector::value_type 是 std::vector<std::unique_ptr<Buffer>> 的元素类型，也就是 std::unique_ptr<Buffer>。
     using BufferPtr = BufferVector::value_type;
 
+    static const int kStagingRetries = 64; // 暂存环满时让出CPU的次数 之后按溢出策略等待或丢弃
+    static const int kDropReportSeconds = 1; // 丢弃统计最多每秒记录一次
+
     void threadFunc();
+    // 当前线程的暂存环 第一次调用时创建并登记到rings_
+    StagingRing* stagingRing();
+    // 暂存环过半时提前唤醒后端 每轮最多加锁通知一次
+    void wakeupBackend();
+    // 把各暂存环中本轮可见的记录按时间戳归并 经merge缓冲写入output 调用前需在mutex_内对每个环beginRead()
+    void harvestStaging(std::vector<std::shared_ptr<StagingRing>>& rings, LargeBuffer& merge, LogFile& output);
+    // 在持有mutex_时调用 队列满了按策略处理 返回false表示这一条被丢弃
+    bool admitInLock(std::unique_lock<std::mutex>& lock, int len);
+    // 把一组缓冲合成一次appendv写入
+    static void writeBuffers(const BufferVector& buffers, LogFile& output);
+    // 把丢弃条数写成一条日志
+    static void reportDropped(uint64_t dropped, OverflowPolicy policy, LogFile& output);
     const int flushInterval_;// 日志刷新时间
     std::atomic<bool> running_;
     const std::string basename_;
@@ -46,4 +124,29 @@ private:
     BufferPtr currentBuffer_;
     BufferPtr nextBuffer_;
     BufferVector buffers_;
+
+    bool directWrite_;
+    LogFile::SyncPolicy syncPolicy_;
+    off_t syncBytes_;
+    bool dropRolledPages_;
+    int compressLevel_;
+    off_t retainBytes_;
+    std::unique_ptr<LogCompressor> compressor_;
+    size_t stagingBytes_;
+    LogRing* crashRing_;
+    const uint64_t id_; // 区分不同的AsyncLogging实例 线程私有的暂存环按它归属
+    std::vector<std::shared_ptr<StagingRing>> rings_; // 由mutex_保护
+    std::atomic<bool> stagingWakeup_;
+    std::atomic<uint64_t> stagingDropped_; // 暂存环一直满而丢弃的条数 不加锁累加 后端并入dropped_
+
+    // 以下由mutex_保护
+    std::condition_variable spaceCond_; // kBlock时前端在这里等待后端取走缓冲
+    OverflowPolicy overflowPolicy_;
+    size_t maxQueuedBuffers_;
+    int sampleRate_;
+    uint64_t sampleCounter_;
+    int currentMessages_;              // currentBuffer_中的日志条数
+    std::vector<int> queuedMessages_;  // buffers_中每个缓冲的日志条数 kDropOldest统计用
+    uint64_t dropped_;                 // 还没有报告的丢弃条数
+    static std::atomic<uint64_t> s_numCreated_;
 };
\ No newline at end of file
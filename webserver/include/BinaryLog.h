@@ -0,0 +1,156 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <string>
+#include <type_traits>
+
+#include "Logger.h"
+#include "Timestamp.h"
+
+/**
+ * 延迟格式化的二进制日志(NanoLog的思路)
+ * 调用点只记录格式串所在位置的编号和参数的原始字节, 文本在离线解码时才生成:
+ *     LOG_BIN(INFO, "accept fd={} from {}", fd, ip);
+ * 格式串用{}占位 每个{}依次对应一个参数. 和LOG_XXX共用日志等级与输出函数, 两种记录可以混在同一个文件里
+ *
+ * 记录格式(多字节整数为本机字节序):
+ *   [kMagic][类型 1字节][记录总长 u16] 之后是记录体
+ *   定义记录 kSiteRecord: [site u32][level u8][line u32][file u16长度+字节][fmt u16长度+字节][参数类型串 u16长度+字节]
+ *   日志记录 kLogRecord:  [site u32][时间 i64 微秒][参数...]
+ * 文本日志的每一行都以日期数字开头 不会出现kMagic(0x1F) 解码时据此区分
+ * 每个调用点第一次使用时输出定义记录; 日志文件滚动时新文件开头会重新写入全部定义(BinaryLog::dictionary)
+ * 解码工具: bin/log_decode
+ **/
+namespace BinaryLog
+{
+    const char kMagic = 0x1F;
+    const char kSiteRecord = 'D';
+    const char kLogRecord = 'E';
+    const int kHeaderSize = 4;          // magic + 类型 + 总长
+    const int kMaxRecordSize = 4000;    // 与LogStream单行上限一致
+    const int kMaxStringArg = 1024;     // 字符串参数最多记录的字节数
+
+    // 参数类型码
+    const char kInt = 'i';
+    const char kUint = 'u';
+    const char kDouble = 'd';
+    const char kString = 's';
+    const char kPointer = 'p';
+    const char kChar = 'c';
+    const char kBool = 'b';
+
+    template<typename T, typename Enable = void>
+    struct TypeCode;
+    template<> struct TypeCode<bool>{static const char value = kBool;};
+    template<> struct TypeCode<char>{static const char value = kChar;};
+    template<typename T>
+    struct TypeCode<T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value && !std::is_same<T, char>::value>::type>{static const char value = kInt;};
+    template<typename T>
+    struct TypeCode<T, typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value && !std::is_same<T, bool>::value>::type>{static const char value = kUint;};
+    template<typename T>
+    struct TypeCode<T, typename std::enable_if<std::is_floating_point<T>::value>::type>{static const char value = kDouble;};
+    template<> struct TypeCode<const char*>{static const char value = kString;};
+    template<> struct TypeCode<char*>{static const char value = kString;};
+    template<> struct TypeCode<std::string>{static const char value = kString;};
+    template<typename T>
+    struct TypeCode<T*, typename std::enable_if<!std::is_same<typename std::remove_cv<T>::type, char>::value>::type>{static const char value = kPointer;};
+
+    template<typename T>
+    using ArgCode = TypeCode<typename std::decay<T>::type>;
+
+    // 把参数的原始字节写到p 空间不够时字符串截断 其他类型放弃 返回写完之后的位置
+    template<typename T>
+    inline char* encodeFixed(char* p, char* end, T value){
+        if(end - p < static_cast<ptrdiff_t>(sizeof(T))) return p;
+        ::memcpy(p, &value, sizeof(T));
+        return p + sizeof(T);
+    }
+    inline char* encodeString(char* p, char* end, const char* str, size_t len){
+        if(end - p < 2) return p;
+        const ptrdiff_t room = end - p - 2;
+        if(len > static_cast<size_t>(kMaxStringArg)) len = kMaxStringArg;
+        if(len > static_cast<size_t>(room)) len = static_cast<size_t>(room);
+        const uint16_t n = static_cast<uint16_t>(len);
+        ::memcpy(p, &n, 2);
+        ::memcpy(p + 2, str, len);
+        return p + 2 + len;
+    }
+    inline char* encodeArg(char* p, char* end, bool v){return encodeFixed<uint8_t>(p, end, v ? 1 : 0);}
+    inline char* encodeArg(char* p, char* end, char v){return encodeFixed<char>(p, end, v);}
+    inline char* encodeArg(char* p, char* end, const char* v){return v ? encodeString(p, end, v, ::strlen(v)) : encodeString(p, end, "(null)", 6);}
+    inline char* encodeArg(char* p, char* end, const std::string& v){return encodeString(p, end, v.data(), v.size());}
+    template<typename T>
+    inline typename std::enable_if<ArgCode<T>::value == kInt, char*>::type encodeArg(char* p, char* end, T v){return encodeFixed<int64_t>(p, end, v);}
+    template<typename T>
+    inline typename std::enable_if<ArgCode<T>::value == kUint, char*>::type encodeArg(char* p, char* end, T v){return encodeFixed<uint64_t>(p, end, v);}
+    template<typename T>
+    inline typename std::enable_if<ArgCode<T>::value == kDouble, char*>::type encodeArg(char* p, char* end, T v){return encodeFixed<double>(p, end, v);}
+    template<typename T>
+    inline typename std::enable_if<ArgCode<T*>::value == kPointer, char*>::type encodeArg(char* p, char* end, T* v){return encodeFixed<uint64_t>(p, end, reinterpret_cast<uintptr_t>(v));}
+
+    // 填写记录头 len包括记录头本身
+    inline void fillHeader(char* buf, char type, int len){
+        buf[0] = kMagic;
+        buf[1] = type;
+        const uint16_t n = static_cast<uint16_t>(len);
+        ::memcpy(buf + 2, &n, 2);
+    }
+    // 是否为定义记录 异步后端据此让定义不经线程私有的暂存环 保证先于任何线程对它的使用落盘
+    inline bool isSiteRecord(const char* data, int len){
+        return len >= kHeaderSize && data[0] == kMagic && data[1] == kSiteRecord;
+    }
+
+    // 当前所有调用点的定义记录 日志文件滚动时写在新文件开头
+    std::string dictionary();
+
+    // 每个LOG_BIN调用点对应一个静态的Site
+    class Site{
+    public:
+        constexpr Site(const char* file, int line, Logger::LogLevel level, const char* format)
+            : file_(file), line_(line), level_(level), format_(format), id_(0){}
+
+        template<typename... Args>
+        void log(const Args&... args){
+            static const char signature[] = {ArgCode<Args>::value..., '\0'};
+            uint32_t id = id_.load(std::memory_order_acquire);
+            if(id == 0) id = registerSite(signature);
+
+            char buf[kMaxRecordSize];
+            char* end = buf + sizeof(buf);
+            char* p = buf + kHeaderSize;
+            p = encodeFixed<uint32_t>(p, end, id);
+            p = encodeFixed<int64_t>(p, end, Timestamp::now().microSecondsSinceEpoch());
+            int expand[] = {0, (p = encodeArg(p, end, args), 0)...};
+            (void)expand;
+            const int len = static_cast<int>(p - buf);
+            fillHeader(buf, kLogRecord, len);
+            Logger::output(buf, len);
+        }
+    private:
+        // 分配编号并输出定义记录 多个线程同时首次使用时只注册一次
+        uint32_t registerSite(const char* signature);
+
+        const char* file_;
+        const int line_;
+        const Logger::LogLevel level_;
+        const char* format_;
+        std::atomic<uint32_t> id_; // 0表示还没有注册
+    };
+}
+
+#ifdef OPEN_LOGGING
+// 与LOG_XXX一样先检查编译期和运行期的日志等级 关闭时参数不会求值; FATAL需要abort 请使用LOG_FATAL
+#define LOG_BIN(level, format, ...) \
+    do{ \
+        static_assert(Logger::level != Logger::FATAL, "use LOG_FATAL for fatal messages"); \
+        if(Logger::level >= LOG_MIN_LEVEL){ \
+            static LogSite logSite_(__FILE__); \
+            static BinaryLog::Site binarySite_(__FILE__, __LINE__, Logger::level, format); \
+            if(logSite_.enabled(Logger::level)) binarySite_.log(__VA_ARGS__); \
+        } \
+    }while(0)
+#else
+#define LOG_BIN(level, format, ...) do{}while(0)
+#endif
@@ -1,19 +1,90 @@
 #pragma once
 
-#include <vector>
 #include <string>
 #include <algorithm>
 #include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
 
+#include "BufferPool.h"
+
+/**
+ * 底层存储从BufferPool按级别分配 第一次写入时才分配
+ * 可读数据被取完(retrieveAll)时 容量超过maxIdleCapacity_的存储会还给BufferPool,
+ * 空闲连接因此不再长期占着一次突发流量撑大的缓冲区
+ * maxSize_限制readFd最多积攒多少可读数据 append不受限制
+ **/
 class Buffer{
 public:
     static const size_t kCheapPrepend = 8;//初始预留的prependabel空间大小
     static const size_t kInitialSize = 1024;
+    static const size_t kNoShrink = SIZE_MAX;
+    static const size_t kNoLimit = SIZE_MAX;
+    static const size_t kMinReadHint = 512;
+    static const size_t kMaxReadHint = 64 * 1024;
+    // 预留区放在BufferPool每级块多出的头部空间里 2的幂大小的数据不会因此升一级
+    static_assert(kCheapPrepend <= BufferPool::kChunkHeadroom, "prepend must fit in the pool headroom");
 
-    explicit Buffer(size_t initalSize = kInitialSize) : buffer_(kCheapPrepend + initalSize), readerIndex_(kCheapPrepend), writerIndex_(kCheapPrepend){}
+    explicit Buffer(size_t initalSize = kInitialSize)
+        : buffer_(nullptr), capacity_(0), readerIndex_(kCheapPrepend), writerIndex_(kCheapPrepend)
+        , initialSize_(initalSize), maxIdleCapacity_(BufferPool::capacityFor(kCheapPrepend + initalSize))
+        , maxSize_(kNoLimit), adaptiveRead_(false), readSizeEwma_(initalSize){}
+    ~Buffer(){ release(); }
+
+    Buffer(const Buffer& rhs)
+        : buffer_(nullptr), capacity_(0), readerIndex_(kCheapPrepend), writerIndex_(kCheapPrepend)
+        , initialSize_(rhs.initialSize_), maxIdleCapacity_(rhs.maxIdleCapacity_)
+        , maxSize_(rhs.maxSize_), adaptiveRead_(rhs.adaptiveRead_), readSizeEwma_(rhs.readSizeEwma_){
+        append(rhs.peek(), rhs.readableBytes());
+    }
+    Buffer& operator=(const Buffer& rhs){
+        if(this != &rhs){
+            Buffer tmp(rhs);
+            swap(tmp);
+        }
+        return *this;
+    }
+    // 移动后源Buffer变为空 但仍然可以继续使用
+    Buffer(Buffer&& rhs) noexcept
+        : buffer_(rhs.buffer_), capacity_(rhs.capacity_), readerIndex_(rhs.readerIndex_), writerIndex_(rhs.writerIndex_)
+        , initialSize_(rhs.initialSize_), maxIdleCapacity_(rhs.maxIdleCapacity_)
+        , maxSize_(rhs.maxSize_), adaptiveRead_(rhs.adaptiveRead_), readSizeEwma_(rhs.readSizeEwma_){
+        rhs.buffer_ = nullptr;
+        rhs.capacity_ = 0;
+        rhs.readerIndex_ = rhs.writerIndex_ = kCheapPrepend;
+    }
+    Buffer& operator=(Buffer&& rhs) noexcept {
+        if(this != &rhs){
+            Buffer tmp(std::move(rhs));
+            swap(tmp);
+        }
+        return *this;
+    }
+    void swap(Buffer& rhs){
+        std::swap(buffer_, rhs.buffer_);
+        std::swap(capacity_, rhs.capacity_);
+        std::swap(readerIndex_, rhs.readerIndex_);
+        std::swap(writerIndex_, rhs.writerIndex_);
+        std::swap(initialSize_, rhs.initialSize_);
+        std::swap(maxIdleCapacity_, rhs.maxIdleCapacity_);
+        std::swap(maxSize_, rhs.maxSize_);
+        std::swap(adaptiveRead_, rhs.adaptiveRead_);
+        std::swap(readSizeEwma_, rhs.readSizeEwma_);
+    }
+
+    // 读空时最多保留多少容量 按BufferPool的级别向上取整 0表示读空就归还全部存储 kNoShrink表示从不归还
+    void setMaxIdleCapacity(size_t bytes){maxIdleCapacity_ = BufferPool::capacityFor(bytes);}
+    // readFd最多积攒多少字节的可读数据 到达上限后readFd不再读取 返回-1并置ENOBUFS; 默认kNoLimit
+    void setMaxSize(size_t bytes){maxSize_ = bytes;}
+    // 可读数据已经到达maxSize_
+    bool full() const {return readableBytes() >= maxSize_;}
+    // readFd按最近读取大小的滑动平均准备可写空间 而不是固定的初始大小
+    void setAdaptiveRead(bool on){adaptiveRead_ = on;}
+    // 当前占用的存储大小
+    size_t capacity() const {return capacity_;}
 
     size_t readableBytes() const {return writerIndex_ - readerIndex_;}
-    size_t writableBytes() const {return buffer_.size() - writerIndex_;}
+    size_t writableBytes() const {return capacity_ > writerIndex_ ? capacity_ - writerIndex_ : 0;}
     size_t prependableBytes() const {return readerIndex_;}
 
     // 返回缓冲区中可读数据的起始地址
@@ -25,6 +96,7 @@ public:
     void retrieveAll(){
         readerIndex_ = kCheapPrepend;
         writerIndex_ = kCheapPrepend;
+        if(capacity_ > maxIdleCapacity_) release(); // 读空了 按策略把存储还给BufferPool
     }
     // 把onMessage函数上报的Buffer数据 转成string类型的数据返回
     std::string retrieveAllAsString() { return retrieveAsString(readableBytes()); }
@@ -39,6 +111,7 @@ public:
     }
     // 把[data, data+len]内存上的数据添加到writable缓冲区当中
     void append(const char* data,size_t len){
+        if(len == 0) return;
         ensureWritableBytes(len);
         std::copy(data,data+len,beginWrite());
         writerIndex_ += len;
@@ -51,26 +124,52 @@ public:
     //通过fd发送数据
     ssize_t writeFd(int fd,int* saveErrno);
 private:
-    // vector底层数组首元素的地址 也就是数组的起始地址
-    char* begin() {return&* buffer_.begin();}
-    const char* begin() const {return &*buffer_.begin();}
+    // 存储的起始地址 还没有分配时指向一块共享的空区域 保证peek()等返回合法指针
+    char* begin() {return buffer_ ? buffer_ : s_emptyStorage_;}
+    const char* begin() const {return buffer_ ? buffer_ : s_emptyStorage_;}
+
+    // 下一次readFd第一块iovec应当准备的大小
+    size_t readSizeHint() const;
+    // 记录本次读取的大小 offered为第一块iovec的大小
+    void updateReadSize(size_t n, size_t offered);
+
+    void release(){
+        BufferPool::deallocate(buffer_, capacity_);
+        buffer_ = nullptr;
+        capacity_ = 0;
+    }
 
     void makeSpace(size_t len){
         /**
         [柜台区][已读区][可读区][可写区]
         | 8位  | 已读 | 待取 | 空位 |
          **/
-        // 也就是说 len > xxx前面剩余的空间 + writer的部分
-        if(writableBytes() + prependableBytes()<len + kCheapPrepend) buffer_.resize(writerIndex_+len);
-        else{
-            size_t readable = readableBytes();
+        size_t readable = readableBytes();
+        // 前面已读的空间加上可写空间足够 把可读数据挪到前面即可
+        if(buffer_ && writableBytes() + prependableBytes() >= len + kCheapPrepend){
             std::copy(begin() + readerIndex_, begin()+writerIndex_, begin()+kCheapPrepend);
-            readerIndex_ = kCheapPrepend;
-            writerIndex_ = readerIndex_ + readable;
+        }else{
+            // 换一块更大的存储 至少按初始大小分配
+            size_t capacity = 0;
+            char* chunk = BufferPool::allocate(kCheapPrepend + std::max(readable + len, initialSize_), &capacity);
+            std::copy(begin() + readerIndex_, begin()+writerIndex_, chunk + kCheapPrepend);
+            release();
+            buffer_ = chunk;
+            capacity_ = capacity;
         }
+        readerIndex_ = kCheapPrepend;
+        writerIndex_ = readerIndex_ + readable;
     }
 
-    std::vector<char> buffer_;
+    static char s_emptyStorage_[kCheapPrepend];
+
+    char* buffer_;          // 从BufferPool分配的存储 未分配时为nullptr
+    size_t capacity_;       // 存储的大小
     size_t readerIndex_;
     size_t writerIndex_;
-};
\ No newline at end of file
+    size_t initialSize_;    // 第一次分配时的最小可写空间
+    size_t maxIdleCapacity_; // 读空时最多保留的容量
+    size_t maxSize_;        // readFd积攒可读数据的上限
+    bool adaptiveRead_;     // 是否按最近的读取大小调整readFd的可写空间
+    size_t readSizeEwma_;   // 最近读取大小的指数滑动平均
+};
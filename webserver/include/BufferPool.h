@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * Buffer底层存储的分级内存池
+ * 按2的幂划分大小级别(1KB ~ 256KB) 每级再多留kChunkHeadroom字节, 2的幂大小的数据加上Buffer的预留区仍落在同一级
+ * 每个线程各自缓存空闲块, 分配和归还都不加锁
+ * 每个线程缓存的空闲内存有上限 超出的块直接还给系统; 超过最大级别的请求直接走operator new
+ * 块可以在任意线程归还 归还到当前线程的缓存中
+ **/
+class BufferPool{
+public:
+    static const size_t kMinChunkSize = 1024;
+    static const size_t kMaxChunkSize = 256 * 1024;
+    static const size_t kChunkHeadroom = 64; // 每级块在2的幂之外多出的字节数
+
+    // allocate(size)实际会得到的容量 0返回0
+    static size_t capacityFor(size_t size);
+
+    // 分配至少size字节 实际得到的容量写入*capacity
+    static char* allocate(size_t size, size_t* capacity);
+    // 归还allocate得到的内存 capacity必须是allocate返回的容量
+    static void deallocate(char* chunk, size_t capacity);
+
+    // 每个线程最多缓存多少字节的空闲块
+    static void setMaxRetainedBytes(size_t bytes);
+    // 当前线程缓存的空闲字节数
+    static size_t retainedBytes();
+};
@@ -12,4 +12,7 @@ using CloseCallback = std::function<void(const TcpConnectionPtr&)>;
 using WriteCompleteCallback = std::function<void(const TcpConnectionPtr&)>;
 using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr&,size_t)>;//当发送缓冲区中的数据量达到某个预设的高水位标记时被调用
 
+// sendFile/sendSplice的数据全部发送完或中途放弃(源出错、连接关闭)时的回调 ok表示是否完整发送
+using FileCompleteCallback = std::function<void(const TcpConnectionPtr&, bool ok)>;
+
 using MessageCallback = std::function<void(const TcpConnectionPtr&, Buffer*,Timestamp)>;
\ No newline at end of file
@@ -16,6 +16,8 @@ class Channel:noncopyable{
 public:
     using EventCallback = std::function<void()>; // 取别名：定义事件回调类型为一个函数包装器，可以接受无参数并返回void的函数
     using ReadEventCallback = std::function<void(Timestamp)>; // 取别名：定义读事件回调类型为一个函数包装器，可以接受一个时间戳参数并返回void的函数
+    // 借用本channel可读通知的回调 removed为true表示channel已从Poller删除 之后不会再通知
+    using ReadableHook = std::function<void(bool removed)>;
 
     Channel(EventLoop* loop, int fd);
     ~Channel();
@@ -29,22 +31,38 @@ public:
 
     void tie(const std::shared_ptr<void>&); // 绑定一个shared_ptr到Channel:防止当channel被手动remove掉 channel还在执行回调操作
     int fd() const { return fd_; } // 获取文件描述符
-    int events() const { return events_; } // 获取事件类型
+    // 获取向Poller注册的事件类型 边沿触发模式下常驻EPOLLOUT并带上EPOLLET; 设置了readableHook_时总是关注读事件
+    int events() const {
+        const int events = readableHook_ ? (events_ | kReadEvent) : events_;
+        return (edgeTriggered_ && events != kNoneEvent) ? (events | kWriteEvent | kEdgeEvent) : events;
+    }
     void set_revents(int revt) { revents_ = revt; } // 设置返回事件
 
     // 位运算设置fd相应的事件状态 相当于epoll_ctl add delete
     void enableReading() {events_ |= kReadEvent; update();}
     void disableReading() { events_ &= ~kReadEvent; update(); }
-    void enableWriting() { events_ |= kWriteEvent; update(); }
-    void disableWriting() { events_ &= ~kWriteEvent; update(); }
+    // 边沿触发模式下EPOLLOUT常驻 只要读事件已注册 开关写事件不需要epoll_ctl
+    void enableWriting() { events_ |= kWriteEvent; if(!edgeTriggered_ || !isReading()) update(); }
+    void disableWriting() { events_ &= ~kWriteEvent; if(!edgeTriggered_ || !isReading()) update(); }
     void disableAll() { events_ = kNoneEvent; update(); }
 
     // 返回fd当前的事件状态
-    bool isNoneEvent() const {return events_ == kNoneEvent;}
+    bool isNoneEvent() const {return events_ == kNoneEvent && !readableHook_;}
     // 位与运算，结果非0则为true
     bool isWriting() const { return events_ & kWriteEvent; }
     bool isReading() const { return events_ & kReadEvent; }
 
+    // 设置边沿触发(EPOLLET)模式 需要在注册到Poller之前调用
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+    bool edgeTriggered() const { return edgeTriggered_; }
+
+    /**
+     * 同一个fd在一个Poller里只能登记一个Channel, 其他对象(如把这个socket当作splice源的TcpConnection)
+     * 需要等它可读时通过hook借用这个Channel: 设置期间可读/挂断/错误只通知hook 不再调用本channel的读、关闭、错误回调
+     * (数据留给hook的设置者去读) 写事件照常处理; 传入空的hook取消
+     **/
+    void setReadableHook(ReadableHook hook) { readableHook_ = std::move(hook); update(); }
+
     int index(){return index_;}
     void set_index(int idx){index_ = idx;}
     // one loop per thread
@@ -58,12 +76,14 @@ private:
     static const int kNoneEvent; // 无事件
     static const int kReadEvent; // 读事件
     static const int kWriteEvent; // 写事件
+    static const int kEdgeEvent; // 边沿触发标志
 
     EventLoop* loop_; // 事件循环指针
     const int fd_; // 文件描述符
     int events_; // 注册fd感兴趣的事件
     int revents_; // Poller返回的具体发生事件
     int index_;
+    bool edgeTriggered_; // 是否工作在边沿触发模式
 
     std::weak_ptr<void> tie_; // 用于防止Channel被手动remove掉时还在执行回调操作
     bool tied_; // 是否绑定了shared_ptr
@@ -73,4 +93,5 @@ private:
     EventCallback writeCallback_; // 写事件回调
     EventCallback closeCallback_; // 关闭事件回调
     EventCallback errorCallback_; // 错误事件回调
+    ReadableHook readableHook_;   // 借用可读通知的回调
 };
\ No newline at end of file
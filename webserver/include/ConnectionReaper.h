@@ -0,0 +1,42 @@
+#pragma once
+
+#include <list>
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "TimerId.h"
+
+class EventLoop;
+class TcpConnection;
+
+/**
+ * 每个subloop一个 负责关闭空闲超时和超过最大存活时间的连接
+ * 连接按最近活跃时间和创建时间分别串在两个链表上 有读写时把连接移到活跃链表尾部(O(1))
+ * 一个周期性的定时器从两个链表头部开始批量关闭已超时的连接, 不需要为每个连接单独设置定时器
+ * 所有接口都只能在所属loop线程中调用
+ **/
+class ConnectionReaper : noncopyable{
+public:
+    using List = std::list<TcpConnection*>;
+
+    // idleTimeout/maxLifetime单位为秒 <=0表示不限制
+    ConnectionReaper(EventLoop* loop, double idleTimeout, double maxLifetime);
+    ~ConnectionReaper();
+
+    // 连接建立时加入
+    void add(TcpConnection* conn);
+    // 连接有读写活动
+    void touch(TcpConnection* conn, Timestamp now);
+    // 连接销毁时移除
+    void remove(TcpConnection* conn);
+private:
+    // 定时扫描两个链表的头部 关闭已超时的连接
+    void sweep();
+
+    EventLoop* loop_;
+    const double idleTimeout_;
+    const double maxLifetime_;
+    List activity_; // 按最近活跃时间排序 头部是最久没有活动的连接
+    List creation_; // 按创建时间排序 头部是最老的连接
+    TimerId sweepTimer_;
+};
@@ -10,6 +10,11 @@
  * 1. epoll_create
  * 2. epoll_ctl (add, mod, del)
  * 3. epoll_wait
+ *
+ * 兴趣集延迟同步: updateChannel只记下fd"待同步" channel自己记录着期望的事件,
+ * 每轮epoll_wait之前统一对比内核中已登记的事件再发epoll_ctl, 和内核一致的直接跳过.
+ * 这样同一轮里先打开又关闭EPOLLOUT不会产生任何系统调用.
+ * removeChannel仍然立即EPOLL_CTL_DEL 因为fd随后就会被close甚至被复用
  **/
 
  class Channel;
@@ -29,9 +34,19 @@ private:
     void fillActiveChannels(int numEvents,ChannelList* activeChannels) const;
     // 更新channel通道 其实就是调用epoll_ctl
     void update(int operation, Channel* channel);
-    
+    // 把待同步的fd的兴趣集提交给内核
+    void syncInterests();
+
+    // 内核中该fd的登记状态
+    struct Interest{
+        int events = 0;       // 已经通过epoll_ctl登记的事件
+        bool dirty = false;   // 是否在dirtyFds_中等待同步
+    };
+
     using EventList = std::vector<epoll_event>; // C++中可以省略struct 直接写epoll_event即可
 
     int epollfd_;      // epoll_create创建返回的fd保存在epollfd_中
     EventList events_; // 用于存放epoll_wait返回的所有发生的事件的文件描述符事件集
+    std::vector<Interest> interests_; // 以fd为下标
+    std::vector<int> dirtyFds_;       // 本轮期望事件可能变化了的fd
  };
\ No newline at end of file
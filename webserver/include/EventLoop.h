@@ -5,14 +5,15 @@
 #include <memory> //智能指针
 #include<vector> 
 # include<atomic>//提供原子操作,避免多线程下对布尔值的竞争条件（比互斥锁更轻量）
-#include<mutex> //提供互斥锁
 
 #include "noncopyable.h" //提供不可拷贝的基类
 #include "Timestamp.h" //时间戳类
 #include "CurrentThread.h" //当前线程相关的函数和变量
 #include "TimerQueue.h" //定时器队列类
+#include "MpscQueue.h" //无锁多生产者单消费者队列
 class Channel;
 class Poller;
+class ZeroCopyHolder;
 
 // 事件循环类 主要包含了两个大模块 Channel Poller(epoll的抽象)
 class EventLoop : noncopyable{
@@ -36,21 +37,35 @@ public:
     void updateChannel(Channel* channel); //更新通道
     void removeChannel(Channel* channel); //移除通道
     bool hasChannel(Channel* channel); //检查通道是否存在
+    Channel* channelOf(int fd); //fd在本loop中登记的通道 没有返回nullptr
+
+    // 负载统计 供EventLoopThreadPool选择subloop时参考
+    void incrConnectionCount() { ++connectionCount_; } //TcpServer分配了一个新连接给本loop
+    void decrConnectionCount() { --connectionCount_; } //本loop上的连接被移除
+    int connectionCount() const { return connectionCount_; } //当前活跃连接数
+    int busyPermille() const { return busyPermille_; } //最近一段时间loop处理事件所占的时间比例(千分比)
+
+    // 本loop上接管已销毁连接零拷贝数据的ZeroCopyHolder 第一次使用时创建 只能在loop线程中调用
+    ZeroCopyHolder* zeroCopyHolder();
 
     bool isInLoopThread() const { return threadId_ == CurrentThread::tid(); } //检查当前线程是否为事件循环所在的线程,threadId_为EventLoop创建时的线程id CurrentThread::tid()为当前线程id
     /**
      * 定时任务相关函数
      */
-    void runAt(Timestamp timestamp, Functor &&cb){
-        timerQueue_->addTimer(std::move(cb), timestamp, 0.0);
+    TimerId runAt(Timestamp timestamp, Functor &&cb){
+        return timerQueue_->addTimer(std::move(cb), timestamp, 0.0);
     }
-    void runAfter(double waitime,Functor &&cb){
+    TimerId runAfter(double waitime,Functor &&cb){
         Timestamp time(addTime(Timestamp::now(),waitime));
-        runAt(time,std::move(cb));
+        return runAt(time,std::move(cb));
     }
-    void runEvery(double interval,Functor &&cb){
+    TimerId runEvery(double interval,Functor &&cb){
         Timestamp timestamp(addTime(Timestamp::now(), interval));
-        timerQueue_->addTimer(std::move(cb), timestamp, interval);
+        return timerQueue_->addTimer(std::move(cb), timestamp, interval);
+    }
+    // 取消定时器 可以跨线程调用 已经结束的定时器取消无效果
+    void cancel(TimerId timerId){
+        timerQueue_->cancel(timerId);
     }
 private:
     void handleRead(); //给eventfd返回的文件描述符wakeupFd_绑定的事件回调 当wakeup()时 即有事件发生时 调用handleRead()读wakeupFd_的8字节 同时唤醒阻塞的epoll_wait
@@ -70,8 +85,13 @@ private:
 
     ChannelList activeChannels_; //活动通道列表，存储当前活跃的通道
 
+    std::atomic_int connectionCount_; //分配到本loop上的活跃连接数
+    std::atomic_int busyPermille_; //忙碌时间占比的指数滑动平均 每轮poll返回到处理完回调计为忙碌
+
     std::atomic_bool callingPendingFunctors_; //标识当前loop是否有需要执行的回调操作
-    std::vector<Functor> pendingFunctors_; //动态数组：存储loop需要执行的所有回调操作
-    std::mutex mutex_; //互斥锁，保护上面vector容器的线程安全操作
+    std::atomic_bool wakeupPending_; //已经有生产者写过wakeupFd_且loop还没开始处理回调 后来的生产者不必重复唤醒
+    MpscQueue<Functor> pendingFunctors_; //无锁队列：存储loop需要执行的所有回调操作 其他线程投递时不需要加锁
+
+    std::unique_ptr<ZeroCopyHolder> zeroCopyHolder_; //已销毁连接上还没完成的零拷贝发送
 };
 
@@ -7,6 +7,7 @@
 
 #include "noncopyable.h"
 #include "Thread.h"
+#include "ThreadAffinity.h"
 
 class EventLoop;
 
@@ -14,7 +15,8 @@ class EventLoopThread : noncopyable{
 public:
     using ThreadInitCallback = std::function<void(EventLoop *)>;
 
-    EventLoopThread(const ThreadInitCallback &cb = ThreadInitCallback(), const std::string& name = std::string());
+    EventLoopThread(const ThreadInitCallback &cb = ThreadInitCallback(), const std::string& name = std::string(),
+                    const ThreadPlacement& placement = ThreadPlacement());
     ~EventLoopThread();
     EventLoop* startLoop();
 private:
@@ -26,4 +28,5 @@ private:
     std::mutex mutex_;//互斥锁
     std::condition_variable cond_;//条件变量
     ThreadInitCallback callback_;
+    ThreadPlacement placement_; // 线程的cpu/NUMA放置策略
 };
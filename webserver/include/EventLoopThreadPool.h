@@ -4,34 +4,59 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <random>
 
 #include "noncopyable.h"
 
 class EventLoop;
 class EventLoopThread;
+class InetAddress;
 
 class EventLoopThreadPool : noncopyable{
 public:
     using ThreadInitCallback = std::function<void(EventLoop*)>;
 
+    // 新连接选择subloop的策略
+    enum SelectPolicy{
+        kRoundRobin,        // 轮询(默认)
+        kLeastConnections,  // 活跃连接数最少的loop
+        kPowerOfTwoChoices, // 随机挑两个loop 取活跃连接数较少的
+        kPowerOfTwoBusy,    // 随机挑两个loop 取最近忙碌时间占比较低的
+        kHashByPeer,        // 按对端ip哈希 同一客户端固定落到同一个loop
+    };
+
     EventLoopThreadPool(EventLoop* baseLoop, const std::string& nameArg);
     ~EventLoopThreadPool();
 
     void setThreadNum(int numThreads){numThreads_ = numThreads;}
+    void setSelectPolicy(SelectPolicy policy){policy_ = policy;}
+    // 第i个loop线程绑定到cpus[i % cpus.size()]
+    void setCpuAffinity(const std::vector<int>& cpus){cpus_ = cpus;}
+    // 第i个loop线程放到NUMA节点nodes[i % nodes.size()]上 并优先从该节点分配内存
+    void setNumaNodes(const std::vector<int>& nodes){numaNodes_ = nodes;}
     void start(const ThreadInitCallback& cb = ThreadInitCallback());
     // 如果工作在多线程中，baseLoop_(mainLoop)会默认以轮询的方式分配Channel给subLoop
     EventLoop* getNextLoop();
+    // 按设置的策略为新连接选择subLoop kHashByPeer需要对端地址
+    EventLoop* getNextLoop(const InetAddress& peerAddr);
 
     std::vector<EventLoop*> getAllLoops();// 获取所有的EventLoop
     bool started() const {return started_;} // 是否已经启动
     const std::string name() const {return name_;} //获取名字
 
 private:
+    EventLoop* selectLoop(const InetAddress* peerAddr);
+    EventLoop* roundRobin();
+
     EventLoop *baseLoop_; // 用户使用muduo创建的loop 如果线程数为1 那直接使用用户创建的loop 否则创建多EventLoop
     std::string name_;//线程池名称，通常由用户指定，线程池中EventLoopThread名称依赖于线程池名称。
     bool started_;//是否已经启动标志
     int numThreads_;//线程池中线程的数量
     int next_; // 新连接到来，所选择EventLoop的索引
+    SelectPolicy policy_; // 选择subloop的策略
+    std::minstd_rand rng_; // 两次随机选择用的随机数 只在baseLoop中使用
     std::vector<std::unique_ptr<EventLoopThread>> threads_;//IO线程的列表
     std::vector<EventLoop *> loops_;//线程池中EventLoop的列表，指向的是EVentLoopThread线程函数创建的EventLoop对象
+    std::vector<int> cpus_; // loop线程绑定的cpu 为空表示不绑核
+    std::vector<int> numaNodes_; // loop线程所在的NUMA节点 为空表示不设置
 };
@@ -2,17 +2,25 @@
 #include <string>
 #include <stdio.h>
 #include <sys/types.h>//off_t
+#include <sys/uio.h>//iovec
 /**
  * @brief 文件工具类，用于处理文件的写入操作
  * 该类封装了对文件的基本操作，包括写入数据和刷新缓冲区
+ * direct为true时不经过stdio缓冲 直接对fd写, appendv可以把多段数据合成一次writev
  */
 class FileUtil{
 public:
-    FileUtil(std::string& file_name);
+    FileUtil(std::string& file_name, bool direct = false);
     ~FileUtil();
 
     void append(const char* data,size_t len);
+    // 按顺序写入多段数据 direct模式下每次writev最多IOV_MAX段
+    void appendv(const struct iovec* iov, int count);
     void flush();//刷新文件缓冲区,将缓冲区中的数据立即写入文件
+    // fdatasync 数据真正落到磁盘
+    void sync();
+    // 写回并丢掉该文件在页缓存中的页 用于已经滚动不再写的文件
+    void dropCache();
 
     /**
      * @brief 获取已写入的字节数
@@ -21,7 +29,8 @@ public:
     off_t writtenBytes() const {return writtenBytes_;}
 private:
     size_t write(const char* data, size_t len);  // 实际写入逻辑
-    FILE* file_; // 文件指针，用于操作文件
+    FILE* file_; // 文件指针，用于操作文件 direct模式下为nullptr
+    int fd_;
     char buffer_[64*1024];       // 文件操作的缓冲区，大小为64KB，用于提高写入效率
     off_t writtenBytes_;        // 记录已写入文件的总字节数，off_t类型用于大文件支持
-};
\ No newline at end of file
+};
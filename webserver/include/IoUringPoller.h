@@ -0,0 +1,84 @@
+#pragma once
+#include <vector>
+#include <linux/io_uring.h>
+
+#include "Poller.h"
+#include "Timestamp.h"
+
+/**
+ * io_uring的使用(直接走系统调用 不依赖liburing):
+ * 1. io_uring_setup 创建SQ/CQ环形队列并mmap到用户态
+ * 2. 把POLL_ADD/POLL_REMOVE写入SQ 攒成一批
+ * 3. io_uring_enter 一次系统调用完成"提交整批SQE + 等待CQE"
+ *
+ * 对EventLoop/Channel的契约与EPollPoller完全一致: poll()返回就绪的Channel及其revents,
+ * 真正的读写仍由TcpConnection自己完成, 所以TcpConnection无需任何改动
+ *
+ * 水平触发的channel使用一次性poll, 触发后在下一次poll()时重新布防(和提交合并在同一次io_uring_enter里);
+ * 边沿触发(EPOLLET)的channel使用multishot poll, 布防一次持续上报
+ **/
+
+class Channel;
+
+class IoUringPoller : public Poller{
+public:
+    IoUringPoller(EventLoop* loop);
+    ~IoUringPoller() override;
+
+    Timestamp poll(int timeoutMs, ChannelList* activeChannels) override;
+    void updateChannel(Channel* channel) override;
+    void removeChannel(Channel* channel) override;
+
+    // 探测当前内核是否支持本实现所需的io_uring特性(EXT_ARG超时、NODROP)
+    static bool isSupported();
+private:
+    static const unsigned kRingEntries = 1024;
+
+    // 每个fd在ring中的登记状态
+    struct PollState{
+        Channel* channel = nullptr;
+        unsigned gen = 0;      // 每次布防递增 用于识别已失效的CQE
+        bool armed = false;    // 当前是否有一个poll请求挂在内核中
+        uint32_t events = 0;   // 挂着的poll请求关心的事件
+        bool rearm = false;    // 一次性poll已触发 等待下一轮重新布防
+        int revents = 0;       // 本轮累计的就绪事件
+        unsigned round = 0;    // revents所属的轮次
+    };
+
+    void setupRing();
+    // 为channel提交一个新的POLL_ADD
+    void arm(int fd, PollState& state);
+    // 撤销挂在内核中的poll请求
+    void disarm(int fd, PollState& state);
+    // 从SQ取一个空闲的sqe 队列满时先把已有的提交掉
+    io_uring_sqe* getSqe();
+    // 提交SQ中的请求并按需等待完成事件
+    int enter(unsigned toSubmit, unsigned minComplete, unsigned flags, int timeoutMs);
+    // 处理CQ中所有完成事件 填写活跃的channel
+    void fillActiveChannels(ChannelList* activeChannels);
+    PollState& stateOf(int fd);
+
+    int ringfd_;
+    // SQ/CQ的mmap区域
+    void* sqRing_;
+    size_t sqRingSize_;
+    void* cqRing_;
+    size_t cqRingSize_;
+    io_uring_sqe* sqes_;
+    size_t sqesSize_;
+
+    unsigned* sqHead_;
+    unsigned* sqTail_;
+    unsigned* sqMask_;
+    unsigned* sqArray_;
+    unsigned sqEntries_;
+    unsigned* cqHead_;
+    unsigned* cqTail_;
+    unsigned* cqMask_;
+    io_uring_cqe* cqes_;
+
+    unsigned pending_;   // 已写入SQ但还没提交给内核的sqe个数
+    unsigned round_;     // 当前poll轮次
+    std::vector<PollState> states_; // 以fd为下标的登记表
+    std::vector<int> rearmFds_;     // 等待重新布防的fd
+};
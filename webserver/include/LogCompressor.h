@@ -0,0 +1,46 @@
+#pragma once
+
+#include <sys/types.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+/**
+ * 滚动出来的日志文件在后台压缩成gzip 并按总字节数清理最旧的日志
+ * LogFile滚动时只把关闭的文件名放进队列(加锁时间只有一次push), 写日志的后端线程不会等待压缩
+ * 压缩线程以最低的CPU优先级和idle IO优先级运行, 尽量不和业务抢磁盘
+ *
+ * 压缩先写到 xxx.log.gz.tmp 完成后rename为 xxx.log.gz 再删掉原文件, 中途崩溃不会留下半个.gz
+ * 清理时只看basename所在目录下 basename.*.log 和 basename.*.log.gz, 正在写的最新文件不会被删除
+ **/
+class LogCompressor : noncopyable{
+public:
+    // level为gzip压缩等级1~9 0表示不压缩只做清理; retainBytes为日志总大小上限 0表示不限制
+    LogCompressor(const std::string& basename, int level, off_t retainBytes);
+    ~LogCompressor();
+
+    void start();
+    // 处理完队列中剩余的文件后退出
+    void stop();
+    // 由日志后端线程调用 只入队不做任何IO
+    void enqueue(const std::string& filename);
+private:
+    void threadFunc();
+    // 压缩成功返回true 原文件随后删除
+    bool compress(const std::string& filename);
+    // 删除最旧的日志直到总大小不超过retainBytes_
+    void enforceRetention();
+
+    const std::string basename_;
+    const int level_;
+    const off_t retainBytes_;
+    Thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<std::string> queue_;
+    bool running_;
+};
@@ -4,14 +4,23 @@
 #include <mutex>
 #include <memory>
 #include <ctime>
+#include <functional>
+#include <string>
+#include <sys/uio.h>
 
 /**
  * @brief 日志文件管理类
  * 负责日志文件的创建、写入、滚动和刷新等操作
  * 支持按大小和时间自动滚动日志文件
+ * 可选直接对fd写(appendv一次writev写完多个缓冲)、fdatasync策略和滚动后丢弃旧文件的页缓存
  */
 class LogFile{
 public:
+    enum SyncPolicy{
+        kSyncNone,        // 只交给页缓存 由内核决定何时写回(默认)
+        kSyncEveryFlush,  // 每次flush()后fdatasync 即后端每轮一次
+        kSyncEveryBytes,  // 每写入syncBytes字节fdatasync一次
+    };
     /**
      * @brief 构造函数
      * @param basename 日志文件基本名称
@@ -25,6 +34,10 @@ public:
             int checkEveryN_ = 1024);
     ~LogFile();
     void append(const char* data, int len);
+    /**
+     * @brief 按顺序写入多段数据 直接写fd时合成一次writev
+     */
+    void appendv(const struct iovec* iov, int count);
     /**
      * @brief 强制将缓冲区数据刷新到磁盘
      */
@@ -35,6 +48,30 @@ public:
      * @return 是否成功滚动日志文件
      */
     bool rollFile();
+    /**
+     * @brief 设置文件头 每个新日志文件打开后先写入header()返回的内容
+     * 二进制日志用它在每个文件开头重新写入调用点定义; 构造时已经打开的当前文件在设置时立即写入一次
+     */
+    void setFileHeader(std::function<std::string()> header);
+    /**
+     * @brief 不经过stdio缓冲直接写fd 当前文件会以新的方式重新打开
+     */
+    void setDirectWrite(bool on);
+    /**
+     * @brief 设置fdatasync策略 bytes只对kSyncEveryBytes有效
+     */
+    void setSyncPolicy(SyncPolicy policy, off_t bytes = 0){
+        syncPolicy_ = policy;
+        syncBytes_ = bytes;
+    }
+    /**
+     * @brief 滚动后把旧文件写回并用posix_fadvise(DONTNEED)丢掉它的页缓存 避免日志挤占其他数据的缓存
+     */
+    void setDropRolledPages(bool on){dropRolledPages_ = on;}
+    /**
+     * @brief 滚动完成后以旧文件名回调 在写日志的线程里执行 回调不能做耗时的操作
+     */
+    void setRollCallback(std::function<void(const std::string&)> cb){rollCallback_ = std::move(cb);}
 private:
     /**
      * @brief 生成日志文件名
@@ -49,6 +86,14 @@ private:
      * @param len 数据长度
      */
     void appendInlock(const char* data,int len);
+    /**
+     * @brief 写入len字节之后 按策略同步、滚动和刷新
+     */
+    void afterAppendInlock(off_t len);
+    /**
+     * @brief 把header_()的内容写入当前文件
+     */
+    void writeHeaderInlock();
 
     const std::string basename_;
     const off_t rollsize_; //滚动文件大小
@@ -62,5 +107,13 @@ private:
     time_t lastRoll_;// 上次roll日志文件时间(秒)
     time_t lastFlush_; // 上次flush日志文件时间(秒)
     std::unique_ptr<FileUtil> file_;
+    std::string filename_; // 当前日志文件名
+    std::function<std::string()> header_;
+    std::function<void(const std::string&)> rollCallback_;
+    bool direct_;
+    SyncPolicy syncPolicy_;
+    off_t syncBytes_;
+    off_t unsyncedBytes_; // 上次fdatasync之后写入的字节数
+    bool dropRolledPages_;
     const static int kRollPerSeconds_ = 60*60*24;
 };
\ No newline at end of file
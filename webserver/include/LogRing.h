@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+#include "noncopyable.h"
+
+/**
+ * 映射到文件的日志环形缓冲
+ * 日志直接memcpy进MAP_SHARED映射的页里, 不需要任何write系统调用;
+ * 进程因为LOG_FATAL或者信号崩溃时 这些页仍然在内核页缓存中 最终会写回文件,
+ * 事后用bin/log_ringdump取出最后capacity字节的日志
+ *
+ * 多个线程写入时用fetch_add预留位置 互不加锁, 写满后从头覆盖最旧的内容
+ * 文件格式: 第一页是Header 之后是capacity字节的数据区, 总写入量writePos记录在Header里
+ * 打开已有的同容量环文件时接着原来的位置写 上一次运行的尾部日志得以保留
+ **/
+class LogRing : noncopyable{
+public:
+    struct Header{
+        char magic[8];          // "LOGRING"
+        uint32_t version;
+        uint32_t dataOffset;    // 数据区在文件中的偏移
+        uint64_t capacity;      // 数据区大小
+        char pad[40];
+        std::atomic<uint64_t> writePos; // 累计预留的字节数 单独占一个cache line
+    };
+    static constexpr char kMagic[8] = {'L', 'O', 'G', 'R', 'I', 'N', 'G', '\0'};
+    static const uint32_t kVersion = 1;
+    static const uint32_t kDataOffset = 4096;
+
+    // capacity会向上取整到页大小 打开失败时valid()返回false append什么也不做
+    LogRing(const std::string& path, size_t capacity);
+    ~LogRing();
+
+    bool valid() const {return header_ != nullptr;}
+    // 可以在任意线程并发调用 签名与Logger::OutputFunc一致
+    void append(const char* data, int len);
+    // 异步地请求内核把脏页写回文件 崩溃保留并不依赖它 只是缩短掉电时的丢失窗口
+    void flush();
+
+    uint64_t writtenBytes() const {return header_ ? header_->writePos.load(std::memory_order_relaxed) : 0;}
+    size_t capacity() const {return capacity_;}
+private:
+    int fd_;
+    size_t capacity_;
+    size_t mappedSize_;
+    char* base_;
+    Header* header_;
+    char* data_;
+};
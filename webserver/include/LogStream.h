@@ -1,5 +1,6 @@
 #pragma once
 #include <string.h>
+#include <stdint.h>
 #include <string>
 #include "noncopyable.h"
 #include "FixedBuffer.h"
@@ -13,6 +14,14 @@ public:
     const char* data_;
     int len_;
 };
+
+// 以十六进制输出整数 如 LOG_DEBUG<<HexTemplate(events) 输出0x1f
+class HexTemplate{
+public:
+    explicit HexTemplate(uint64_t value) : value_(value){}
+
+    uint64_t value_;
+};
 // LogStream类用于管理日志输出流，重载输出流运算符<<，实现前端将各种类型的值写入内部缓冲区
 class LogStream : noncopyable{
 public:
@@ -52,8 +61,11 @@ public:
 
     // 重载输出流运算符<<，用于将浮点数写入缓冲区
     LogStream &operator<<(float number);
-    // 重载输出流运算符<<，用于将双精度浮点数写入缓冲区
+    // 重载输出流运算符<<，用于将双精度浮点数写入缓冲区 输出能精确还原的最短形式
     LogStream &operator<<(double);
+    // 指针以0x开头的十六进制输出
+    LogStream &operator<<(const void *);
+    LogStream &operator<<(const HexTemplate& h);
 
     // 重载输出流运算符<<，用于将字符写入缓冲区
     LogStream &operator<<(char str);
@@ -70,6 +82,7 @@ private:
     static constexpr int kMaxNumberSize = 32;
     template <typename T>
     void formatInteger(T num);
+    void formatHex(uintptr_t num);
 
     // 内部缓冲区对象
     Buffer buffer_;
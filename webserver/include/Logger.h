@@ -5,12 +5,20 @@
 #include <string.h>
 #include <string>
 #include <errno.h>
+#include <time.h>
 #include "LogStream.h"
 #include<functional>
+#include<atomic>
 #include "Timestamp.h"
 
 #define OPEN_LOGGING // 定义了一个宏，通过宏定义可以在不修改代码的情况下，控制功能开关
 
+// 编译期最低日志等级(对应Logger::LogLevel的值) 低于它的LOG_XXX语句整条被编译器删掉
+// 例如 -DLOG_MIN_LEVEL=2 去掉所有TRACE和DEBUG
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
 // SourceFile的作用是提取文件名
 class SourceFile{
 public:
@@ -43,6 +51,8 @@ public:
         LEVEL_COUNT,
     };
     Logger(const char *filename,int line, LogLevel level);
+    // 限流的日志语句使用 suppressed>0时在行尾注明上次输出以来跳过了多少条
+    Logger(const char *filename,int line, LogLevel level, uint64_t suppressed);
     ~Logger();
     // 流是会改变的
     LogStream& stream() { return impl_.stream_; }
@@ -52,6 +62,15 @@ public:
     using FlushFunc = std::function<void()>;
     static void setOutput(OutputFunc);
     static void setFlush(FlushFunc);
+    // 不经过格式化 直接交给输出函数(二进制日志使用)
+    static void output(const char* data, int len);
+
+    // 运行期的全局日志等级 默认INFO 设置了环境变量MUDUO_LOG_DEBUG/MUDUO_LOG_TRACE时默认DEBUG/TRACE
+    static LogLevel logLevel();
+    static void setLogLevel(LogLevel level);
+    // 按模块覆盖全局等级 模块名是源文件名去掉扩展名 如"EPollPoller"
+    static void setModuleLevel(const std::string& module, LogLevel level);
+    static void clearModuleLevel(const std::string& module);
 private:
     class Impl{
     public:
@@ -65,6 +84,7 @@ private:
         LogLevel level_;
         int line_;
         SourceFile basename_;
+        uint64_t suppressed_;
     };
 private:
     Impl impl_;
@@ -72,17 +92,100 @@ private:
 
 // 获取errno信息
 const char* getErrnoMsg(int savedErrno);
+
+/**
+ * 每条LOG_XXX语句对应一个静态的LogSite 缓存该源文件生效的日志等级
+ * 等级配置每变化一次全局代数加一, 代数没变时判断只需要两次原子读和一次比较, 不做任何格式化
+ **/
+class LogSite{
+public:
+    constexpr explicit LogSite(const char* file) : file_(file), threshold_(0), generation_(0){}
+
+    bool enabled(Logger::LogLevel level){
+        const unsigned gen = s_generation_.load(std::memory_order_acquire);
+        if(generation_.load(std::memory_order_acquire) != gen) resolve(gen);
+        return level >= threshold_.load(std::memory_order_relaxed);
+    }
+    // 配置变化时调用 让所有LogSite在下次使用时重新计算
+    static void invalidate(){s_generation_.fetch_add(1, std::memory_order_acq_rel);}
+private:
+    void resolve(unsigned gen);
+
+    const char* file_;
+    std::atomic<int> threshold_;
+    std::atomic<unsigned> generation_; // 0表示还没计算过 全局代数从1开始
+    static std::atomic<unsigned> s_generation_;
+};
+
+/**
+ * LOG_EVERY_N/LOG_FIRST_N/LOG_EVERY_T每个调用点对应一个静态的LogThrottle
+ * 被限流的一条只有一次原子操作(FIRST_N超过之后只是一次读) 不做任何格式化
+ * 返回true表示这一条输出, *suppressed为上次输出以来跳过的条数
+ **/
+class LogThrottle{
+public:
+    constexpr LogThrottle() : count_(0), suppressed_(0), nextTime_(0){}
+
+    // 第1、n+1、2n+1...条输出
+    bool everyN(uint64_t n, uint64_t* suppressed){
+        const uint64_t count = count_.fetch_add(1, std::memory_order_relaxed);
+        if(n > 1 && count % n != 0) return false;
+        *suppressed = count == 0 || n <= 1 ? 0 : n - 1;
+        return true;
+    }
+    // 只输出前n条
+    bool firstN(uint64_t n, uint64_t* suppressed){
+        if(count_.load(std::memory_order_relaxed) >= n) return false;
+        *suppressed = 0;
+        return count_.fetch_add(1, std::memory_order_relaxed) < n;
+    }
+    // 每seconds秒最多输出一条
+    bool everyT(double seconds, uint64_t* suppressed){
+        struct timespec ts;
+        ::clock_gettime(CLOCK_MONOTONIC_COARSE, &ts); // vdso 不进内核
+        const int64_t now = static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+        int64_t next = nextTime_.load(std::memory_order_relaxed);
+        if(now < next || !nextTime_.compare_exchange_strong(next, now + static_cast<int64_t>(seconds * 1000000), std::memory_order_relaxed)){
+            suppressed_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        *suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+private:
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> suppressed_;
+    std::atomic<int64_t> nextTime_; // 单调时钟 微秒
+};
+
 /**
  * 当日志等级小于对应等级才会输出
  * 比如设置等级为FATAL，则logLevel等级大于DEBUG和INFO，DEBUG和INFO等级的日志就不会输出
  */
 #ifdef OPEN_LOGGING
-#define LOG_DEBUG Logger(__FILE__, __LINE__, Logger::DEBUG).stream()
-#define LOG_INFO Logger(__FILE__, __LINE__, Logger::INFO).stream()
-#define LOG_WARN Logger(__FILE__, __LINE__, Logger::WARN).stream()
-#define LOG_ERROR Logger(__FILE__, __LINE__, Logger::ERROR).stream()
+// 每个调用点一个静态的LogSite/LogThrottle 放在lambda里才能用在表达式中
+#define LOG_SITE_ ([]() -> LogSite& {static LogSite logSite_(__FILE__); return logSite_;}())
+#define LOG_THROTTLE_ ([]() -> LogThrottle& {static LogThrottle logThrottle_; return logThrottle_;}())
+#define LOG_ENABLED_(level) (Logger::level >= LOG_MIN_LEVEL && LOG_SITE_.enabled(Logger::level))
+// 只执行一次的for代替if/else: 宏出现在不带花括号的if语句中不会错配else 也不会触发-Wdangling-else; 关闭时<<后面的表达式都不会求值
+#define LOG_IF_ENABLED(level) \
+    for(bool logOnce_ = LOG_ENABLED_(level); logOnce_; logOnce_ = false) \
+        Logger(__FILE__, __LINE__, Logger::level).stream()
+// 先判断等级再经过限流 被等级关掉的语句不计数; 不要用于FATAL(被限流时不会abort)
+#define LOG_THROTTLED(level, check) \
+    for(uint64_t logSuppressed_ = 0, logOnce_ = LOG_ENABLED_(level) && LOG_THROTTLE_.check; logOnce_; logOnce_ = 0) \
+        Logger(__FILE__, __LINE__, Logger::level, logSuppressed_).stream()
+// 用法: LOG_EVERY_N(ERROR, 100)<<"..."  LOG_EVERY_T(WARN, 1.0)<<"..."
+#define LOG_EVERY_N(level, n) LOG_THROTTLED(level, everyN(n, &logSuppressed_))
+#define LOG_FIRST_N(level, n) LOG_THROTTLED(level, firstN(n, &logSuppressed_))
+#define LOG_EVERY_T(level, seconds) LOG_THROTTLED(level, everyT(seconds, &logSuppressed_))
+#define LOG_TRACE LOG_IF_ENABLED(TRACE)
+#define LOG_DEBUG LOG_IF_ENABLED(DEBUG)
+#define LOG_INFO LOG_IF_ENABLED(INFO)
+#define LOG_WARN LOG_IF_ENABLED(WARN)
+#define LOG_ERROR LOG_IF_ENABLED(ERROR)
+// FATAL之后要abort 不受等级控制
 #define LOG_FATAL Logger(__FILE__, __LINE__, Logger::FATAL).stream()
 #else
 #define LOG(level) LogStream()
 #endif
-
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <utility>
+
+#include "noncopyable.h"
+
+/**
+ * 无锁的多生产者单消费者队列(Vyukov MPSC)
+ * push可以在任意线程并发调用 只需要一次原子交换 不加锁
+ * pop只能由唯一的消费者线程(EventLoop所在线程)调用
+ *
+ * head_指向最新插入的节点 tail_指向哨兵节点 哨兵之后才是第一个有效元素
+ **/
+template<typename T>
+class MpscQueue : noncopyable{
+public:
+    MpscQueue() : head_(new Node), tail_(head_.load()){}
+    ~MpscQueue(){
+        T value;
+        while(pop(value)){}
+        delete tail_;
+    }
+
+    // 生产者: 先交换head_占位 再把前驱节点链接到新节点
+    void push(T value){
+        Node* node = new Node(std::move(value));
+        Node* prev = head_.exchange(node);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // 消费者: 取出最早插入的元素 队列为空时返回false
+    bool pop(T& value){
+        Node* tail = tail_;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if(next == nullptr){
+            if(head_.load() == tail) return false;
+            // 生产者已经交换了head_但还没来得及链接next 这个窗口只有几条指令 短暂让出等待
+            while((next = tail->next.load(std::memory_order_acquire)) == nullptr) std::this_thread::yield();
+        }
+        value = std::move(next->value);
+        tail_ = next; // next成为新的哨兵
+        delete tail;
+        return true;
+    }
+
+    // 只能由消费者调用
+    bool empty() const {
+        return tail_->next.load(std::memory_order_acquire) == nullptr && head_.load() == tail_;
+    }
+private:
+    struct Node{
+        Node() : next(nullptr){}
+        explicit Node(T&& v) : next(nullptr), value(std::move(v)){}
+        std::atomic<Node*> next;
+        T value;
+    };
+
+    std::atomic<Node*> head_; // 生产者竞争的一端
+    Node* tail_;              // 只有消费者访问的一端
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <utility>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "noncopyable.h"
+#include "Slice.h"
+#include "Callbacks.h"
+
+/**
+ * TcpConnection的发送队列: 由拷贝进来的小块数据、按引用排队的Slice、文件区间和splice源组成的链
+ * 小数据拷贝进队尾的数据段 大数据只持有Slice的引用, 不会像单个连续Buffer那样反复拷贝和扩容
+ * 拷贝数据段的存储来自BufferPool 发送完就归还
+ * writeFd每次处理队首: 连续的内存数据段用一次writev发出最多IOV_MAX段,
+ * 文件区间用sendfile, pipe/socket源经过内部pipe用splice搬运, 都按队列顺序和内存数据交错发送
+ *
+ * 开启MSG_ZEROCOPY后 不小于阈值的Slice单独用sendmsg(MSG_ZEROCOPY)发送,
+ * 内核直接引用这段用户内存, 所以Slice要一直持有到socket错误队列中出现对应的完成通知(reapZeroCopy)
+ **/
+class OutputQueue : noncopyable{
+public:
+    // 小于该大小的Slice直接拷贝 省掉一个iovec
+    static const size_t kCopyThreshold = 512;
+    // 拷贝数据段的最大长度 超过后新开一个数据段
+    static const size_t kMaxCopySegment = 64 * 1024;
+    // 单次sendfile/splice最多搬运的字节数
+    static const size_t kMaxFileChunk = 1024 * 1024;
+    static const size_t kMaxSpliceChunk = 64 * 1024;
+
+    // 文件/splice数据段结束时的回调及是否完整发送
+    using Completion = std::pair<FileCompleteCallback, bool>;
+    // 等待完成通知的零拷贝数据 按内核分配的序号排列
+    using PinnedList = std::deque<std::pair<uint32_t, Slice>>;
+
+    OutputQueue() : bytes_(0), blockedSource_(-1), pipeBytes_(0), zeroCopyThreshold_(0), zeroCopyNextSeq_(0), zeroCopyCopied_(0){ pipe_[0] = pipe_[1] = -1; }
+    ~OutputQueue();
+
+    // 待发送的字节数 包括还没发送的文件区间
+    size_t readableBytes() const {return bytes_;}
+    bool empty() const {return segments_.empty();}
+
+    // 拷贝[data, data+len]到队尾
+    void append(const char* data, size_t len);
+    // 按引用排队
+    void append(const Slice& slice);
+    // 排队文件fd的[offset, offset+count)区间 用sendfile发送
+    void appendFile(int fd, off_t offset, size_t count, const FileCompleteCallback& cb);
+    // 排队从pipe或socket srcFd读取的count字节 用splice发送 srcFd需要是非阻塞的
+    void appendSplice(int srcFd, size_t count, const FileCompleteCallback& cb);
+
+    // 发送队首的数据 已发送的部分直接从队列中移除
+    // 返回写入fd的字节数 出错或fd不可写时返回-1并设置saveErrno
+    ssize_t writeFd(int fd, int* saveErrno);
+    // 上一次writeFd因splice源暂时没有数据而停下时返回源fd 否则返回-1
+    int blockedSourceFd() const {return blockedSource_;}
+    // 阻塞中的splice源不会再有数据(比如所属连接已经关闭) 这一段以失败结束 后面的数据照常发送
+    void abandonBlockedSource();
+    // 取出已经结束的文件/splice数据段的回调
+    std::vector<Completion> takeCompletions();
+    // 丢弃所有待发送的数据 未完成的文件/splice回调以失败结束
+    void abort();
+
+    // 不小于bytes的Slice使用MSG_ZEROCOPY发送 0表示关闭 socket需要已经设置SO_ZEROCOPY
+    void setZeroCopyThreshold(size_t bytes){zeroCopyThreshold_ = bytes;}
+    size_t zeroCopyThreshold() const {return zeroCopyThreshold_;}
+    bool zeroCopyEnabled() const {return zeroCopyThreshold_ > 0;}
+    // 读取fd错误队列中的零拷贝完成通知 释放已经完成的Slice 返回处理的通知个数
+    int reapZeroCopy(int fd){return reapZeroCopy(fd, zeroCopyPinned_, &zeroCopyCopied_);}
+    // 同上 作用于给定的列表 连接销毁后由ZeroCopyHolder使用
+    static int reapZeroCopy(int fd, PinnedList& pinned, uint64_t* copied);
+    // 取出还在等待完成通知的数据 连接销毁时交给ZeroCopyHolder
+    PinnedList takeZeroCopyPinned(){
+        PinnedList pinned;
+        pinned.swap(zeroCopyPinned_);
+        return pinned;
+    }
+    // 还在等待完成通知的字节数
+    size_t zeroCopyPinnedBytes() const;
+    // 内核退回到拷贝方式完成的次数(例如回环地址上的发送)
+    uint64_t zeroCopyCopiedCount() const {return zeroCopyCopied_;}
+private:
+    enum Kind{
+        kBytes,  // 拷贝进来的数据
+        kSlice,  // 按引用排队的数据
+        kFile,   // 文件区间
+        kSplice, // pipe/socket源
+    };
+    struct Segment{
+        Kind kind = kBytes;
+        Buffer bytes;       // kBytes: 拷贝进来的数据 存储在第一次写入时才分配
+        Slice slice;        // kSlice: 按引用排队的数据
+        int fd = -1;        // kFile/kSplice: 源fd
+        off_t offset = 0;   // kFile: 下一次发送的文件偏移
+        size_t remaining = 0; // kFile/kSplice: 还没有从源读出的字节数
+        FileCompleteCallback done;
+
+        bool inMemory() const {return kind == kBytes || kind == kSlice;}
+        const char* data() const {return kind == kSlice ? slice.data() : bytes.peek();}
+        size_t size() const {return kind == kSlice ? slice.size() : bytes.readableBytes();}
+    };
+    bool useZeroCopy(const Segment& seg) const;
+    ssize_t writeMemory(int fd, int* saveErrno);
+    ssize_t writeZeroCopy(int fd, int* saveErrno);
+    ssize_t writeFile(int fd, int* saveErrno);
+    ssize_t writeSplice(int fd, int* saveErrno);
+    // 队首的文件/splice数据段结束
+    void finishFront(bool ok);
+    // 移除已经发送的n个字节
+    void consume(size_t n);
+    void closePipe();
+
+    std::deque<Segment> segments_;
+    size_t bytes_; // 队列中待发送的总字节数
+    std::vector<Completion> completions_;
+    int blockedSource_;
+    int pipe_[2];      // splice使用的内部pipe 第一次用到时创建
+    size_t pipeBytes_; // 内部pipe中还没写到socket的字节数
+
+    size_t zeroCopyThreshold_;
+    uint32_t zeroCopyNextSeq_; // 内核为每次成功的MSG_ZEROCOPY发送分配的序号 从0开始递增
+    PinnedList zeroCopyPinned_; // 等待完成通知的数据 按序号排列
+    uint64_t zeroCopyCopied_;
+};
@@ -1,7 +1,6 @@
 #pragma once
 
 #include<vector>
-#include<unordered_map>
 
 #include "noncopyable.h"
 #include "Timestamp.h"
@@ -22,13 +21,22 @@ public:
 
     // 判断参数channel是否在当前的Poller当中
     bool hasChannel(Channel* channel) const;
+    // 已登记的fd对应的channel 未登记返回nullptr
+    Channel* channelOf(int fd) const {
+        return static_cast<size_t>(fd) < channels_.size() ? channels_[fd] : nullptr;
+    }
 
     // EventLoop可以通过该接口获取默认的IO复用的具体实现
     static Poller* newDefaultPoller(EventLoop* loop);
 protected:
-    // map的key:sockfd value:sockfd所属的channel通道类型
-    using ChannelMap = std::unordered_map<int,Channel*>;
+    // 登记/注销channel 维护下面的fd表
+    void addChannelEntry(Channel* channel);
+    void removeChannelEntry(int fd);
+
+    // 以sockfd为下标的channel表 fd是内核从小到大分配的 直接下标访问不用哈希
+    using ChannelMap = std::vector<Channel*>;
     ChannelMap channels_;
+    size_t numChannels_; // 表中已登记的channel个数
 private:
     EventLoop* ownerLoop_; // 定义Poller所属的事件循环EventLoop
 };
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <stddef.h>
+
+#include "Buffer.h"
+
+/**
+ * 引用计数的只读字节片段
+ * 拷贝Slice只增加引用计数 不拷贝数据, 底层内存在最后一个引用释放时才回收
+ * 用于把发送的数据跨线程交给loop线程, 以及在发送队列中按引用排队
+ **/
+class Slice{
+public:
+    Slice() : data_(nullptr), size_(0){}
+    // 接管string的内存 不拷贝
+    explicit Slice(std::string&& str){
+        auto owner = std::make_shared<std::string>(std::move(str));
+        data_ = owner->data();
+        size_ = owner->size();
+        owner_ = std::move(owner);
+    }
+    // 接管Buffer中的可读数据 不拷贝
+    explicit Slice(Buffer&& buf){
+        auto owner = std::make_shared<Buffer>(std::move(buf));
+        data_ = owner->peek();
+        size_ = owner->readableBytes();
+        owner_ = std::move(owner);
+    }
+    // 引用外部内存 由owner负责其生命周期
+    Slice(std::shared_ptr<const void> owner, const char* data, size_t len)
+        : owner_(std::move(owner)), data_(data), size_(len){}
+
+    // 拷贝一份数据
+    static Slice copyOf(const void* data, size_t len){
+        return Slice(std::string(static_cast<const char*>(data), len));
+    }
+
+    const char* data() const {return data_;}
+    size_t size() const {return size_;}
+    bool empty() const {return size_ == 0;}
+
+    // 丢弃前n个字节(已经发送出去的部分)
+    void removePrefix(size_t n){
+        if(n > size_) n = size_;
+        data_ += n;
+        size_ -= n;
+    }
+    // 与当前Slice共享内存的子片段
+    Slice subslice(size_t offset, size_t len) const {
+        if(offset > size_) offset = size_;
+        if(len > size_ - offset) len = size_ - offset;
+        return Slice(owner_, data_ + offset, len);
+    }
+private:
+    std::shared_ptr<const void> owner_;
+    const char* data_;
+    size_t size_;
+};
@@ -19,6 +19,8 @@ public:
     void setReuseAddr(bool on);
     void setReusePort(bool on);
     void setKeepAlive(bool on);
+    // 开启SO_ZEROCOPY 内核不支持时返回false
+    bool setZeroCopy(bool on);
 private:
     const int sockfd_;
 };
\ No newline at end of file
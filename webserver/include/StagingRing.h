@@ -0,0 +1,133 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <memory>
+
+#include "noncopyable.h"
+
+/**
+ * 单生产者单消费者的字节环形队列 用作每个线程私有的日志暂存区
+ * 生产者(写日志的线程)push一条带时间戳的记录 消费者(日志后端线程)批量读出
+ * 两端各自只写自己的游标 不需要任何锁
+ *
+ * 记录格式: [Header 16字节][日志内容] 整体按16字节对齐
+ * 记录放不下环尾剩余的空间时写一个kWrap头 消费者遇到它直接跳到环首
+ **/
+class StagingRing : noncopyable{
+public:
+    // capacity会向上取整为2的幂
+    explicit StagingRing(size_t capacity)
+        : capacity_(roundUpPowerOfTwo(capacity))
+        , mask_(capacity_ - 1)
+        , data_(new char[capacity_])
+        , closed_(false)
+        , tail_(0)
+        , cachedHead_(0)
+        , head_(0)
+        , readPos_(0)
+        , readLimit_(0)
+    {
+    }
+
+    // 生产者: 空间不够或者记录太大时返回false 由调用者走其他路径
+    bool push(int64_t time, const char* data, int len){
+        if(!fits(len)) return false;
+        const size_t need = recordSize(len);
+        const uint64_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t offset = static_cast<size_t>(tail & mask_);
+        const size_t toEnd = capacity_ - offset;
+        const size_t total = need + (toEnd < need ? toEnd : 0);
+        if(tail + total - cachedHead_ > capacity_){
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if(tail + total - cachedHead_ > capacity_) return false;
+        }
+        char* p = data_.get() + offset;
+        if(toEnd < need){
+            reinterpret_cast<Header*>(p)->len = kWrap;
+            p = data_.get();
+        }
+        Header* header = reinterpret_cast<Header*>(p);
+        header->time = time;
+        header->len = static_cast<uint32_t>(len);
+        ::memcpy(p + sizeof(Header), data, len);
+        tail_.store(tail + total, std::memory_order_release);
+        return true;
+    }
+
+    // 长度为len的记录能否放进环 超过容量一半的记录push总是失败
+    bool fits(int len) const {return recordSize(len) <= capacity_ / 2;}
+
+    // 生产者: 已用空间是否超过一半 用来决定是否提前唤醒后端
+    bool overHalf() const {
+        return tail_.load(std::memory_order_relaxed) - cachedHead_ > capacity_ / 2;
+    }
+
+    // 消费者: 以调用时已发布的记录为本轮的读取范围
+    void beginRead(){
+        readPos_ = head_.load(std::memory_order_relaxed);
+        readLimit_ = tail_.load(std::memory_order_acquire);
+    }
+    // 消费者: 查看本轮下一条记录 没有了返回false
+    bool front(int64_t* time, const char** data, int* len){
+        while(readPos_ != readLimit_){
+            const size_t offset = static_cast<size_t>(readPos_ & mask_);
+            const Header* header = reinterpret_cast<const Header*>(data_.get() + offset);
+            if(header->len == kWrap){
+                readPos_ += capacity_ - offset;
+                continue;
+            }
+            *time = header->time;
+            *data = data_.get() + offset + sizeof(Header);
+            *len = static_cast<int>(header->len);
+            return true;
+        }
+        return false;
+    }
+    // 消费者: 跳过front返回的记录
+    void pop(){
+        const Header* header = reinterpret_cast<const Header*>(data_.get() + (readPos_ & mask_));
+        readPos_ += recordSize(static_cast<int>(header->len));
+    }
+    // 消费者: 记录内容已经拷走 把空间还给生产者
+    void endRead(){head_.store(readPos_, std::memory_order_release);}
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    // 所属线程退出后置位 后端读空之后即可回收
+    void close(){closed_.store(true, std::memory_order_release);}
+    bool closed() const {return closed_.load(std::memory_order_acquire);}
+private:
+    struct Header{
+        int64_t time;  // 写入时间 微秒
+        uint32_t len;  // 日志内容长度 kWrap表示环尾的填充
+        uint32_t reserved;
+    };
+    static const uint32_t kWrap = UINT32_MAX;
+    static const size_t kAlign = sizeof(Header);
+
+    static size_t recordSize(int len){
+        return (sizeof(Header) + static_cast<size_t>(len) + kAlign - 1) & ~(kAlign - 1);
+    }
+    static size_t roundUpPowerOfTwo(size_t n){
+        size_t size = 4096;
+        while(size < n) size <<= 1;
+        return size;
+    }
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<char[]> data_;
+    std::atomic<bool> closed_;
+
+    // 生产者一端
+    alignas(64) std::atomic<uint64_t> tail_;
+    uint64_t cachedHead_; // 生产者缓存的head_ 空间不够时才重新读取
+    // 消费者一端
+    alignas(64) std::atomic<uint64_t> head_;
+    uint64_t readPos_;
+    uint64_t readLimit_;
+};
@@ -3,16 +3,20 @@
 #include <memory>
 #include <string>
 #include <atomic>
+#include <list>
 
 #include "noncopyable.h"
 #include "InetAddress.h"
 #include "Callbacks.h"
 #include "Buffer.h"
 #include "Timestamp.h"
+#include "Slice.h"
+#include "OutputQueue.h"
 
 class Channel;
 class EventLoop;
 class Socket;
+class ConnectionReaper;
 
 /**
  * TcpServer => Acceptor => 有一个新用户连接，通过accept函数拿到connfd
@@ -30,13 +34,32 @@ public:
     const InetAddress& peerAddress() const { return peerAddr_; }
 
     bool connected() const { return state_ == kConnected; }
+    // 连接的socket 可以作为另一条连接sendSplice的源
+    int fd() const;
 
-    // 发送数据
+    // 发送数据 不在loop线程时会先拷贝一份再转交给loop线程
     void send(const std::string &buf);
-    void sendFile(int fileDescriptor, off_t offset, size_t count); 
+    // 接管数据的所有权 跨线程时不拷贝
+    void send(std::string &&buf);
+    void send(Buffer &&buf);
+    // 按引用发送 跨线程时只增加引用计数
+    void send(const Slice &slice);
+    // 用sendfile发送文件的[offset, offset+count)区间 和其他send的数据按顺序排队 内核发送缓冲区满时等EPOLLOUT再继续
+    // cb在整个区间发送完或中途放弃时调用 调用之前fileDescriptor需要保持打开
+    void sendFile(int fileDescriptor, off_t offset, size_t count, const FileCompleteCallback& cb = FileCompleteCallback());
+    // 用splice把pipe或socket srcFd中的count字节转发出去 srcFd需要是非阻塞的 源暂时没有数据时会等它可读
+    // srcFd是同一个loop上另一个TcpConnection的socket时借用它的Channel等待可读 不会重复注册;
+    // 这种情况下源连接应当先stopRead() 否则它自己的handleRead会把数据读走
+    void sendSplice(int srcFd, size_t count, const FileCompleteCallback& cb = FileCompleteCallback());
     
+    // 暂停/恢复读取 暂停期间对端的数据留在内核接收缓冲区
+    void startRead();
+    void stopRead();
+
     // 关闭半连接
     void shutdown();
+    // 不等待发送缓冲区 直接关闭连接
+    void forceClose();
 
     void setConnectionCallback(const ConnectionCallback &cb)
     { connectionCallback_ = cb; }
@@ -49,6 +72,19 @@ public:
     void setHighWaterMarkCallback(const HighWaterMarkCallback &cb, size_t highWaterMark)
     { highWaterMarkCallback_ = cb; highWaterMark_ = highWaterMark; }
 
+    // 边沿触发模式 需要在connectEstablished之前设置
+    void setEdgeTriggered(bool on);
+    // 接收缓冲区读空时最多保留的容量 见Buffer::setMaxIdleCapacity
+    void setBufferMaxIdleCapacity(size_t bytes){ inputBuffer_.setMaxIdleCapacity(bytes); }
+    // 接收缓冲区最多积攒的字节数 上层一直不取走数据时关闭连接 见Buffer::setMaxSize
+    void setBufferMaxSize(size_t bytes){ inputBuffer_.setMaxSize(bytes); }
+    // 接收缓冲区按最近的读取大小自适应准备空间
+    void setAdaptiveReadSize(bool on){ inputBuffer_.setAdaptiveRead(on); }
+    // 不小于bytes的Slice用MSG_ZEROCOPY发送 0表示关闭 需要在connectEstablished之前设置 之后只能在loop线程中调用
+    void setZeroCopyThreshold(size_t bytes);
+    // 空闲/存活时间超时管理 需要在connectEstablished之前设置
+    void setReaper(ConnectionReaper* reaper){ pendingReaper_ = reaper; }
+
     // 连接建立
     void connectEstablished();
     // 连接销毁
@@ -66,18 +102,39 @@ private:
     void handleWrite();
     void handleClose();
     void handleError();
+    // 接收缓冲区满了而上层没有取走数据 关闭连接
+    void closeOnFullBuffer();
 
-    void sendInLoop(const void* data,size_t len);
+    // slice不为空时 没能立即写出的部分按引用排队而不拷贝
+    void sendInLoop(const void* data,size_t len,const Slice* slice = nullptr);
+    void sendSliceInLoop(const Slice& slice);
     void shutdownInLoop();
-    void sendFileInLoop(int fileDescriptor,off_t offset,size_t count);
+    void forceCloseInLoop();
+    void sendFileInLoop(int fileDescriptor,off_t offset,size_t count,const FileCompleteCallback& cb);
+    void sendSpliceInLoop(int srcFd,size_t count,const FileCompleteCallback& cb);
+    // 把发送队列中已经结束的文件回调投递到loop中执行
+    void dispatchFileCompletions();
+    // splice源暂时没有数据 停止关注可写事件 改为等待源可读
+    void waitSpliceSource(int srcFd);
+    void handleSourceReadable();
+    // 借用的源Channel通知可读 removed表示它已经从Poller删除
+    void handleBorrowedSource(bool removed);
+    void stopWaitingSource();
+    void startReadInLoop();
+    void stopReadInLoop();
     EventLoop *loop_; // 这里是baseloop还是subloop由TcpServer中创建的线程数决定 若为多Reactor 该loop_指向subloop 若为单Reactor 该loop_指向baseloop
     const std::string name_;
     std::atomic_int state_;
     bool reading_;//连接是否在监听读事件
+    bool edgeTriggered_; // 是否工作在边沿触发模式 该模式下读写都要进行到EAGAIN为止
 
     // socket channel 这里和acceptor类似 Acceptor => mainloop    TcpConnection => subloop
     std::unique_ptr<Socket> socket_;
     std::unique_ptr<Channel> channel_;
+    std::unique_ptr<Channel> sourceChannel_; // 等待splice源可读时使用
+    bool waitingSource_; // 是否正在等待splice源可读
+    bool sourceBorrowed_; // 等待中的源由本loop上别的Channel登记 通过它的ReadableHook等待
+    Channel* sourceOwner_; // 借用的Channel 它从Poller删除后置空
 
     const InetAddress localAddr_;
     const InetAddress peerAddr_;
@@ -90,7 +147,15 @@ private:
     CloseCallback closeCallback_; // 关闭连接的回调
     size_t highWaterMark_; // 高水位阈值
 
+    friend class ConnectionReaper;
+    ConnectionReaper* pendingReaper_; // 连接建立时要加入的reaper
+    ConnectionReaper* reaper_; // 当前所在的reaper 没有开启超时管理或已被移除时为nullptr
+    std::list<TcpConnection*>::iterator activityIt_; // 在reaper活跃链表中的位置
+    std::list<TcpConnection*>::iterator creationIt_; // 在reaper创建时间链表中的位置
+    Timestamp lastActivity_; // 最近一次读写的时间
+    Timestamp createTime_;   // 连接建立的时间
+
     // 数据缓冲区
     Buffer inputBuffer_; // 接收数据的缓冲区
-    Buffer outputBuffer_; // 发送数据的缓冲区 用户send向outputBuffer_发
+    OutputQueue outputQueue_; // 发送队列 用户send没能立即写出的数据在这里排队
 };
\ No newline at end of file
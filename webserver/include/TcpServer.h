@@ -9,6 +9,8 @@
 #include <memory>
 #include <atomic>
 #include <unordered_map>
+#include <vector>
+#include <mutex>
 
 #include "EventLoop.h"
 #include "Acceptor.h"
@@ -18,6 +20,7 @@
 #include "Callbacks.h"
 #include "TcpConnection.h"
 #include "Buffer.h"
+#include "ConnectionReaper.h"
 
 // 对外的服务器编程使用的类
 class TcpServer{
@@ -27,6 +30,7 @@ public:
     enum Option{
         kNoReusePort,//不允许重用本地端口
         kReusePort,//允许重用本地端口
+        kReusePortPerLoop,//每个subloop各自持有一个SO_REUSEPORT的监听socket 由内核在它们之间分配新连接
     };
 
     TcpServer(EventLoop* loop,const InetAddress& listenAddr, const std::string &nameArg,Option option = kNoReusePort);
@@ -37,8 +41,34 @@ public:
     void setMessageCallback(const MessageCallback& cb){messageCallback_ = cb;}
     void setWriteCompleteCallback(const WriteCompleteCallback& cb){writeCompleteCallback_ = cb;}
 
+    // 新连接使用边沿触发(EPOLLET)模式 需要在start之前设置
+    void setEdgeTriggered(bool on){edgeTriggered_ = on;}
+
+    // 连接超过seconds秒没有读写就关闭 <=0表示不限制(默认) 需要在start之前设置
+    void setIdleTimeout(double seconds){idleTimeout_ = seconds;}
+    // 连接最长存活seconds秒 <=0表示不限制(默认) 需要在start之前设置
+    void setMaxConnectionLifetime(double seconds){maxConnectionLifetime_ = seconds;}
+
+    // 连接的接收缓冲区读空时最多保留多少容量 默认0即读空就把存储还给BufferPool
+    // 大量空闲连接时可以显著降低内存占用 Buffer::kNoShrink表示从不归还
+    void setBufferMaxIdleCapacity(size_t bytes){bufferMaxIdleCapacity_ = bytes;}
+    // 连接的接收缓冲区最多积攒多少字节 满了之后回调仍不取走数据就关闭连接 默认0不限制
+    void setBufferMaxSize(size_t bytes){bufferMaxSize_ = bytes;}
+    // 连接的readFd按最近的读取大小自适应准备接收空间 默认关闭
+    void setAdaptiveReadSize(bool on){adaptiveReadSize_ = on;}
+    // 不小于bytes的Slice(send(std::string&&)/send(Buffer&&)/send(Slice))用MSG_ZEROCOPY发送 默认0关闭
+    // 回环地址上内核会退回拷贝 只有真实网卡上才有收益
+    void setZeroCopyThreshold(size_t bytes){zeroCopyThreshold_ = bytes;}
+    // 每个线程的BufferPool最多缓存多少字节空闲存储
+    void setBufferPoolRetainedBytes(size_t bytes){BufferPool::setMaxRetainedBytes(bytes);}
+
     //设置底层subloop的个数
     void setThreadNum(int numThreads);
+    // 设置新连接选择subloop的策略 默认轮询
+    void setLoopSelectPolicy(EventLoopThreadPool::SelectPolicy policy){threadPool_->setSelectPolicy(policy);}
+    // 设置subloop线程绑定的cpu/NUMA节点 需要在start之前调用
+    void setCpuAffinity(const std::vector<int>& cpus){threadPool_->setCpuAffinity(cpus);}
+    void setNumaNodes(const std::vector<int>& nodes){threadPool_->setNumaNodes(nodes);}
     /**
      * 如果没有监听, 就启动服务器(监听).
      * 多次调用没有副作用.
@@ -47,6 +77,8 @@ public:
     void start();
 private:
     void newConnection(int sockfd, const InetAddress& peerAddr);
+    // 在ioLoop上创建并建立TcpConnection kReusePortPerLoop模式下由subloop自己的Acceptor直接调用
+    void createConnection(EventLoop* ioLoop, int sockfd, const InetAddress& peerAddr);
     void removeConnection(const TcpConnectionPtr& conn);
     void removeConnectionInLoop(const TcpConnectionPtr& conn);
 
@@ -56,8 +88,11 @@ private:
 
     const std::string ipPort_;
     const std::string name_;
+    const InetAddress listenAddr_;
+    const Option option_;
 
     std::unique_ptr<Acceptor> acceptor_; // 运行在mainloop 任务是监听新连接事件
+    std::vector<std::unique_ptr<Acceptor>> loopAcceptors_; // kReusePortPerLoop模式下每个subloop各自的Acceptor
 
     std::shared_ptr<EventLoopThreadPool> threadPool_;
     ConnectionCallback connectionCallback_; //有新连接时的回调
@@ -66,7 +101,16 @@ private:
 
     ThreadInitCallback threadInitCallback_; //loop线程初始化回调
     int numThreads_;//线程池中线程的数量
+    bool edgeTriggered_; // 新连接是否使用边沿触发模式
+    double idleTimeout_; // 空闲超时(秒)
+    double maxConnectionLifetime_; // 最大存活时间(秒)
+    size_t bufferMaxIdleCapacity_; // 连接接收缓冲区读空时保留的容量
+    size_t bufferMaxSize_; // 连接接收缓冲区的上限 0表示不限制
+    bool adaptiveReadSize_; // 连接是否自适应调整读取空间
+    size_t zeroCopyThreshold_; // MSG_ZEROCOPY的阈值 0表示关闭
+    std::unordered_map<EventLoop*, std::unique_ptr<ConnectionReaper>> reapers_; // 每个subloop的超时管理 start之后只读
     std::atomic_int started_;
-    int nextConnId_;
+    std::atomic_int nextConnId_;
+    std::mutex mutex_; // kReusePortPerLoop模式下多个subloop会同时增删连接
     ConnectionMap connections_; //保存所有连接
 };
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+
+/**
+ * loop线程的放置策略: 绑定到指定cpu 并让该线程的内存分配优先落在本地NUMA节点
+ * 防止调度器把IO线程及其cache中热的Buffer在不同核、不同socket之间迁移
+ **/
+struct ThreadPlacement{
+    std::vector<int> cpus; // 允许运行的cpu 为空表示不绑核
+    int numaNode = -1;     // 内存优先分配的NUMA节点 <0表示不设置
+};
+
+namespace ThreadAffinity
+{
+    // 把当前线程绑定到cpus中的cpu上
+    bool bindToCpus(const std::vector<int>& cpus);
+    // 当前线程之后的内存分配(Buffer扩容、内存池新块等)优先从node节点获取
+    bool preferMemoryNode(int node);
+    // 读取/sys/devices/system/node/node<N>/cpulist 得到该NUMA节点包含的cpu
+    std::vector<int> cpusOfNode(int node);
+    // 对当前线程应用放置策略
+    void apply(const ThreadPlacement& placement);
+}
@@ -3,12 +3,39 @@
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include <functional>
+#include <atomic>
+
+/**
+ * 时间轮槽位中的侵入式双向循环链表节点
+ * 定时器自身就是链表节点 插入和删除都是O(1) 不需要额外分配容器节点
+ */
+struct TimerLink{
+    TimerLink() : prev(this), next(this){}
+
+    bool linked() const {return next != this;}
+    // 插入到pos之前(pos为槽位的哨兵时即插入到链表尾部)
+    void linkBefore(TimerLink* pos){
+        prev = pos->prev;
+        next = pos;
+        pos->prev->next = this;
+        pos->prev = this;
+    }
+    void unlink(){
+        prev->next = next;
+        next->prev = prev;
+        prev = next = this;
+    }
+
+    TimerLink* prev;
+    TimerLink* next;
+};
 
 /**
  * Timer用于描述一个定时器
  * 定时器回调函数，下一次超时时刻，重复定时器的时间间隔等
+ * Timer结束后由TimerQueue回收复用, 每次复用都会分配新的序号
  */
-class Timer : noncopyable{
+class Timer : public TimerLink, noncopyable{
 public:
     using TimerCallback = std::function<void()>;
 
@@ -16,7 +43,9 @@ public:
         : callback_(move(cb)),
         expiration_(when),
         interval_(interval),
-        repeat_(interval>0.0)
+        repeat_(interval>0.0),
+        sequence_(++s_numCreated_),
+        canceled_(false)
         {}
     void run() const{
         callback_();
@@ -24,12 +53,23 @@ public:
 
     Timestamp expiration() const {return expiration_;}
     bool repeat() const {return repeat_;}
+    int64_t sequence() const {return sequence_;}
+    bool canceled() const {return canceled_;}
+    void cancel() {canceled_ = true;}
 
     // 重启定时器(如果是非重复事件则到期时间置为0)
     void restart(Timestamp now);
+    // 复用一个已回收的Timer
+    void reset(TimerCallback cb, Timestamp when, double interval);
+    // 回收: 释放回调持有的资源 序号置0使旧的TimerId失效
+    void release();
 private:
-    const TimerCallback callback_;  // 定时器回调函数
+    TimerCallback callback_;        // 定时器回调函数
     Timestamp expiration_;          // 下一次的超时时刻
-    const double interval_;         // 超时时间间隔，如果是一次性定时器，该值为0
-    const bool repeat_;             // 是否重复(false 表示是一次性定时器)
-};
\ No newline at end of file
+    double interval_;               // 超时时间间隔，如果是一次性定时器，该值为0
+    bool repeat_;                   // 是否重复(false 表示是一次性定时器)
+    int64_t sequence_;              // 全局唯一序号 用于校验TimerId
+    bool canceled_;                 // 在到期执行过程中或加入时间轮之前被取消
+
+    static std::atomic<int64_t> s_numCreated_;
+};
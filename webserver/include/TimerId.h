@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+
+class Timer;
+
+/**
+ * TimerId用于取消定时器 由Timer指针和全局唯一的序号组成
+ * Timer对象会被TimerQueue回收复用 序号对不上说明该定时器已经结束或被取消
+ */
+class TimerId{
+public:
+    TimerId() : timer_(nullptr), sequence_(0){}
+    TimerId(Timer* timer, int64_t seq) : timer_(timer), sequence_(seq){}
+
+    friend class TimerQueue;
+private:
+    Timer* timer_;
+    int64_t sequence_;
+};
@@ -2,13 +2,20 @@
 
 #include<Timestamp.h> //时间戳类
 #include<Channel.h> //通道类
+#include<Timer.h>
+#include<TimerId.h>
 
 #include<vector> //提供动态数组容器
-#include<set> //提供集合容器
 
 class EventLoop; //前向声明EventLoop类
-class Timer;
 
+/**
+ * 分层时间轮实现的定时器队列
+ * 时间精度为1ms(一个tick), 第0层256个槽位覆盖256ms, 其上4层各64个槽位, 总跨度约49.7天
+ * 定时器按到期tick挂在对应槽位的侵入式链表中, 插入和取消都是O(1);
+ * 指针推进到高层槽位的边界时把该槽位的定时器重新分配(cascade)到低层
+ * timerfd只在最近一个非空槽位(或下一次cascade)发生变化时才重新设置
+ */
 class TimerQueue {
 public:
     using TimerCallback = std::function<void()>;
@@ -16,30 +23,56 @@ public:
     explicit TimerQueue(EventLoop* loop);
     ~TimerQueue();
 
-    void addTimer(TimerCallback cb,Timestamp when,double interval);
+    // 添加定时器 可以跨线程调用
+    TimerId addTimer(TimerCallback cb,Timestamp when,double interval);
+    // 取消定时器 可以跨线程调用
+    void cancel(TimerId timerId);
 private:
-    // 使用别名,避免类型冗长,Timer*需要手动释放内存
-    using Entry = std::pair<Timestamp, Timer*>;
-    using TimerList = std::set<Entry>;
+    static const int64_t kTickMicroSeconds = 1000;
+    static const int kRootBits = 8;
+    static const int kRootSize = 1 << kRootBits;
+    static const int kLevelBits = 6;
+    static const int kLevelSize = 1 << kLevelBits;
+    static const int kLevels = 4;    // 第0层之上的层数
+
     // 在本loop中添加定时器
     void addTimerInLoop(Timer* timer);
+    void cancelInLoop(TimerId timerId);
     // 定时器读事件触发函数
     void handleRead();
     // 重新设置timerfd_
     void resetTimerfd(int timerfd_, Timestamp expiration);
-    // 移除所有已到期的定时器
-    // 1.获取到期的定时器
-    // 2.重置这些定时器（销毁或者重复定时任务）
-    std::vector<Entry> getExpired(Timestamp now);
-    void reset(const std::vector<Entry>& expired,Timestamp now);
-    // 插入定时器的内部方法
-    bool insert(Timer* timer);
+    // 把定时器挂到对应的槽位 返回需要为它唤醒的tick
+    uint64_t insert(Timer* timer);
+    // 推进时间轮直到tick(包含) 到期的定时器依次放入expired
+    void advance(uint64_t tick, std::vector<Timer*>& expired);
+    // 把第level层index槽位的定时器重新分配到低层 返回index
+    int cascade(int level, int index);
+    // 第level层index槽位下一次被cascade的tick
+    uint64_t cascadeTick(int level, int index) const;
+    // 下一个需要处理的tick(最近的非空第0层槽位或cascade点)
+    uint64_t nextWakeTick() const;
+    // 按nextWakeTick重新设置timerfd
+    void rearm();
+    // 从回收池中取出或新建Timer
+    Timer* newTimer(TimerCallback cb,Timestamp when,double interval);
+    void freeTimer(Timer* timer);
+
+    static uint64_t toTick(Timestamp when);
+    // 第level层(从1开始)的槽位对应的tick位移
+    static int levelShift(int level) {return kRootBits + (level - 1) * kLevelBits;}
 
     EventLoop* loop_;           // 所属的EventLoop
     const int timerfd_;         // timerfd是Linux提供的定时器接口
     Channel timerfdChannel_;    // 封装timerfd_文件描述符
-    // Timer list sorted by expiration
-    TimerList timers_;          // 定时器队列（set内部实现是红黑树）
 
-    bool callingExpiredTimers_; // 标明正在获取超时定时器
-};
\ No newline at end of file
+    TimerLink root_[kRootSize];             // 第0层 每个槽位一个tick
+    TimerLink levels_[kLevels][kLevelSize]; // 第1~4层
+    uint64_t currentTick_;      // 下一个要处理的tick
+    uint64_t armedTick_;        // timerfd_当前设置的tick 未设置时为UINT64_MAX
+    size_t count_;              // 时间轮中的定时器个数
+    std::vector<Timer*> freeTimers_; // 回收的Timer 复用以免每个定时器都堆分配
+    std::vector<Timer*> expired_;    // 本次到期的定时器
+
+    bool callingExpiredTimers_; // 标明正在执行到期定时器
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "TimerId.h"
+#include "OutputQueue.h"
+
+class EventLoop;
+
+/**
+ * 每个loop一个 接管已经销毁的连接上还没收到完成通知的MSG_ZEROCOPY发送
+ * 连接关闭时内核可能还在发送这些页 对应的Slice要留到完成通知到达之后才能释放,
+ * 所以连接把socket dup一份连同这些Slice交给这里, 定时读取错误队列, 全部完成后才关闭dup的fd并释放
+ * 超过kMaxHoldSeconds仍未完成(比如对端一直不读)时用SO_LINGER{1,0}复位连接 内核丢弃发送队列后再释放
+ * 所有接口都只能在所属loop线程中调用
+ **/
+class ZeroCopyHolder : noncopyable{
+public:
+    static constexpr double kPollInterval = 0.01;
+    static constexpr double kMaxHoldSeconds = 30.0;
+
+    explicit ZeroCopyHolder(EventLoop* loop);
+    // 剩下的连接全部复位后释放
+    ~ZeroCopyHolder();
+
+    // 接管fd上还在等待完成通知的数据 fd仍由调用者关闭
+    void adopt(int fd, OutputQueue::PinnedList&& pinned);
+    // 正在等待完成通知的连接数和字节数
+    size_t size() const {return entries_.size();}
+    size_t pinnedBytes() const;
+private:
+    struct Entry{
+        int fd;                       // dup出来的fd 保证错误队列可读
+        OutputQueue::PinnedList pinned;
+        Timestamp deadline;
+    };
+    // 定时读取各连接的完成通知
+    void poll();
+    // 复位连接并关闭fd 之后内核不再引用这些页
+    static void abortEntry(Entry& entry);
+
+    EventLoop* loop_;
+    std::vector<Entry> entries_;
+    bool polling_;    // 是否已经安排了下一次poll
+    TimerId pollTimer_;
+};
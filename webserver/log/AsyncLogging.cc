@@ -1,5 +1,24 @@
 #include "AsyncLogging.h"
+#include "Timestamp.h"
+#include "BinaryLog.h"
 #include <stdio.h>
+#include <algorithm>
+#include <thread>
+
+std::atomic<uint64_t> AsyncLogging::s_numCreated_(0);
+
+namespace
+{
+    // 线程私有的暂存环 线程退出时关闭 由后端读空后回收
+    struct StagingSlot{
+        uint64_t owner = 0;
+        std::shared_ptr<StagingRing> ring;
+        ~StagingSlot(){
+            if(ring) ring->close();
+        }
+    };
+    thread_local StagingSlot t_staging;
+}
 
 AsyncLogging::AsyncLogging(const std::string& basename, off_t rollSize,int flushInterval)
     :flushInterval_(flushInterval),
@@ -11,7 +30,24 @@ AsyncLogging::AsyncLogging(const std::string& basename, off_t rollSize,int flush
     cond_(),
     currentBuffer_(new LargeBuffer),
     nextBuffer_(new LargeBuffer),
-    buffers_()
+    buffers_(),
+    directWrite_(true),
+    syncPolicy_(LogFile::kSyncNone),
+    syncBytes_(0),
+    dropRolledPages_(false),
+    compressLevel_(0),
+    retainBytes_(0),
+    stagingBytes_(0),
+    crashRing_(nullptr),
+    id_(++s_numCreated_),
+    stagingWakeup_(false),
+    stagingDropped_(0),
+    overflowPolicy_(kDropOldest),
+    maxQueuedBuffers_(25),
+    sampleRate_(10),
+    sampleCounter_(0),
+    currentMessages_(0),
+    dropped_(0)
 {
     currentBuffer_->bzero();
     nextBuffer_->bzero();
@@ -19,21 +55,186 @@ AsyncLogging::AsyncLogging(const std::string& basename, off_t rollSize,int flush
 }
 // 调用此函数解决前端把LOG_XXX<<"..."传递给后端，后端再将日志消息写入日志文件
 void AsyncLogging::append(const char* logline,int len){
-    std::lock_guard<std::mutex> lg(mutex_);
-    // 缓冲区剩余的空间足够写入
-    if(currentBuffer_->avail()>static_cast<size_t>(len)) currentBuffer_->append(logline,len);
-    else{
+    if(crashRing_) crashRing_->append(logline, len);
+    // 定义记录走共享缓冲: 它在调用点id发布之前写入, 后端每轮先写共享缓冲再归并暂存环, 使用它的记录不会排到它前面
+    if(stagingBytes_ > 0 && !BinaryLog::isSiteRecord(logline, len)){
+        StagingRing* ring = stagingRing();
+        if(ring->fits(len)){
+            const int64_t now = Timestamp::now().microSecondsSinceEpoch();
+            // 环满了唤醒后端等它腾出空间; 退回共享缓冲区会让这一条排到本线程更早的日志前面
+            // 让出kStagingRetries次仍然满 kBlock继续等 其他策略丢弃这一条
+            bool block = false;
+            for(int retry = 0; running_; ++retry){
+                if(ring->push(now, logline, len)){
+                    if(ring->overHalf()) wakeupBackend();
+                    return;
+                }
+                if(retry == kStagingRetries){
+                    std::lock_guard<std::mutex> lg(mutex_);
+                    block = overflowPolicy_ == kBlock;
+                }
+                if(retry >= kStagingRetries && !block){
+                    ++stagingDropped_;
+                    return;
+                }
+                wakeupBackend();
+                if(retry < kStagingRetries) std::this_thread::yield();
+                else std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }else{
+            // 放不进环的长行只能走共享缓冲区 先等本线程之前的记录都被后端取走
+            while(running_ && !ring->empty()){
+                wakeupBackend();
+                std::this_thread::yield();
+            }
+        }
+    }
+    std::unique_lock<std::mutex> lg(mutex_);
+    if(!admitInLock(lg, len)){
+        ++dropped_;
+        return;
+    }
+    // 缓冲区剩余的空间不够写入
+    if(currentBuffer_->avail()<=static_cast<size_t>(len)){
         buffers_.push_back(std::move(currentBuffer_));//将装满的currentbuffer缓冲区放入buffers
+        queuedMessages_.push_back(currentMessages_);
+        currentMessages_ = 0;
         if(nextBuffer_) currentBuffer_ = std::move(nextBuffer_);//将备用buffer替换上
         else currentBuffer_.reset(new LargeBuffer);
         // 唤醒后端线程写入磁盘
         cond_.notify_one();
     }
+    // 触发轮换的这一条写进新的缓冲
+    currentBuffer_->append(logline,len);
+    ++currentMessages_;
+}
+
+bool AsyncLogging::admitInLock(std::unique_lock<std::mutex>& lock, int len){
+    if(maxQueuedBuffers_ == 0) return true;
+    if(overflowPolicy_ == kSample && buffers_.size() >= (maxQueuedBuffers_ + 1) / 2 && sampleCounter_++ % sampleRate_ != 0) return false;
+    // 当前缓冲还写得下或者队列没满 不需要处理
+    if(currentBuffer_->avail() > static_cast<size_t>(len) || buffers_.size() < maxQueuedBuffers_) return true;
+
+    switch(overflowPolicy_){
+    case kBlock:
+        cond_.notify_one();
+        spaceCond_.wait(lock, [this](){return buffers_.size() < maxQueuedBuffers_ || !running_;});
+        return true;
+    case kDropOldest:{
+        // 最早排队的缓冲直接丢弃 腾出的内存留作备用缓冲
+        dropped_ += queuedMessages_.front();
+        queuedMessages_.erase(queuedMessages_.begin());
+        BufferPtr oldest = std::move(buffers_.front());
+        buffers_.erase(buffers_.begin());
+        if(!nextBuffer_){
+            oldest->reset();
+            nextBuffer_ = std::move(oldest);
+        }
+        return true;
+    }
+    default: // kDropNewest kSample
+        return false;
+    }
+}
+
+void AsyncLogging::writeBuffers(const BufferVector& buffers, LogFile& output){
+    struct iovec iov[32];
+    int count = 0;
+    for(auto& buffer : buffers){
+        if(buffer->length() == 0) continue;
+        if(count == 32){
+            output.appendv(iov, count);
+            count = 0;
+        }
+        iov[count].iov_base = const_cast<char*>(buffer->data());
+        iov[count].iov_len = buffer->length();
+        ++count;
+    }
+    if(count > 0) output.appendv(iov, count);
+}
+
+void AsyncLogging::reportDropped(uint64_t dropped, OverflowPolicy policy, LogFile& output){
+    static const char* policyName[] = {"block", "drop-newest", "drop-oldest", "sample"};
+    Timestamp now = Timestamp::now();
+    time_t seconds = now.secondsSinceEpoch();
+    struct tm tm_time;
+    localtime_r(&seconds, &tm_time);
+    char buf[256];
+    int len = snprintf(buf, sizeof(buf), "%4d/%02d/%02d %02d:%02d:%02d.%06d WARN  AsyncLogging dropped %llu messages (overflow policy: %s)\n",
+        tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday, tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec,
+        static_cast<int>(now.microSecondsSinceEpoch() % Timestamp::kMicroSecondsPerSecond),
+        static_cast<unsigned long long>(dropped), policyName[policy]);
+    output.append(buf, len);
+}
+
+StagingRing* AsyncLogging::stagingRing(){
+    if(t_staging.owner != id_){
+        if(t_staging.ring) t_staging.ring->close();
+        t_staging.ring = std::make_shared<StagingRing>(stagingBytes_);
+        t_staging.owner = id_;
+        std::lock_guard<std::mutex> lg(mutex_);
+        rings_.push_back(t_staging.ring);
+    }
+    return t_staging.ring.get();
+}
+
+void AsyncLogging::wakeupBackend(){
+    if(!stagingWakeup_.exchange(true)){
+        std::lock_guard<std::mutex> lg(mutex_);
+        cond_.notify_one();
+    }
+}
+
+void AsyncLogging::harvestStaging(std::vector<std::shared_ptr<StagingRing>>& rings, LargeBuffer& merge, LogFile& output){
+    // 每个环当前的队首记录 各环内部本来就是按时间有序的 每次取时间最早的一条即可
+    struct Cursor{
+        StagingRing* ring;
+        int64_t time;
+        const char* data;
+        int len;
+        bool valid;
+    };
+    std::vector<Cursor> cursors;
+    cursors.reserve(rings.size());
+    for(auto& ring : rings){
+        Cursor cursor{ring.get(), 0, nullptr, 0, false};
+        cursor.valid = ring->front(&cursor.time, &cursor.data, &cursor.len);
+        cursors.push_back(cursor);
+    }
+    for(;;){
+        Cursor* earliest = nullptr;
+        for(auto& cursor : cursors){
+            if(cursor.valid && (earliest == nullptr || cursor.time < earliest->time)) earliest = &cursor;
+        }
+        if(earliest == nullptr) break;
+        if(merge.avail() <= static_cast<size_t>(earliest->len)){
+            output.append(merge.data(), merge.length());
+            merge.reset();
+        }
+        if(merge.avail() > static_cast<size_t>(earliest->len)) merge.append(earliest->data, earliest->len);
+        else output.append(earliest->data, earliest->len); // 比整个归并缓冲还大 直接写
+        earliest->ring->pop();
+        earliest->valid = earliest->ring->front(&earliest->time, &earliest->data, &earliest->len);
+    }
+    for(auto& ring : rings) ring->endRead();
+    if(merge.length() > 0){
+        output.append(merge.data(), merge.length());
+        merge.reset();
+    }
 }
 
 void AsyncLogging::threadFunc(){
     // output写入磁盘接口
     LogFile output(basename_,rollSize_);
+    // 二进制日志的调用点定义在每个新文件开头重写一遍 每个文件都能单独解码
+    output.setFileHeader(BinaryLog::dictionary);
+    output.setDirectWrite(directWrite_);
+    output.setSyncPolicy(syncPolicy_, syncBytes_);
+    output.setDropRolledPages(dropRolledPages_);
+    if(compressor_){
+        LogCompressor* compressor = compressor_.get();
+        output.setRollCallback([compressor](const std::string& filename){compressor->enqueue(filename);});
+    }
     BufferPtr newbuffer1(new LargeBuffer); // 生成新buffer替换currentbuffer_
     BufferPtr newbuffer2(new LargeBuffer); // 生成新buffer2替换newBuffer_，其目的是为了防止后端缓冲区全满前端无法写入
     newbuffer1->bzero();
@@ -41,18 +242,45 @@ void AsyncLogging::threadFunc(){
     // 缓冲区数组置为16个，用于和前端缓冲区数组进行交换
     BufferVector buffersToWrite;
     buffersToWrite.reserve(16);
+    // 归并暂存环用的缓冲 只在打开暂存时分配
+    BufferPtr mergeBuffer(stagingBytes_ > 0 ? new LargeBuffer : nullptr);
+    std::vector<std::shared_ptr<StagingRing>> rings;
+    time_t lastDropReport = 0;
     while(running_){
+        uint64_t dropped = 0;
+        OverflowPolicy policy;
         {
             //保证了其他前端线程无法向前端buffer写入数据
             std::unique_lock<std::mutex> lg(mutex_);
-            if(buffers_.empty()) cond_.wait_for(lg,std::chrono::seconds(3));//如果buffers为空，则等待3秒
+            if(buffers_.empty() && !stagingWakeup_) cond_.wait_for(lg,std::chrono::seconds(3));//如果buffers为空，则等待3秒
+            stagingWakeup_ = false;
             buffers_.push_back(std::move(currentBuffer_));
             currentBuffer_ = std::move(newbuffer1);
             if(!nextBuffer_) nextBuffer_ = std::move(newbuffer2);
             buffersToWrite.swap(buffers_);
+            queuedMessages_.clear();
+            currentMessages_ = 0;
+            spaceCond_.notify_all();
+            dropped_ += stagingDropped_.exchange(0);
+            time_t now = time(NULL);
+            if(dropped_ > 0 && now - lastDropReport >= kDropReportSeconds){
+                dropped = dropped_;
+                dropped_ = 0;
+                lastDropReport = now;
+            }
+            policy = overflowPolicy_;
+            // 线程已经退出且读空的暂存环不再登记
+            rings_.erase(std::remove_if(rings_.begin(), rings_.end(), [](const std::shared_ptr<StagingRing>& ring){
+                return ring->closed() && ring->empty();
+            }), rings_.end());
+            rings = rings_;
+            // 暂存环的读取范围和交换缓冲在同一临界区内确定 本轮读到的环记录都晚于本轮交换出的缓冲
+            for(auto& ring : rings) ring->beginRead();
         }
         // 从待写缓冲区取出数据通过LogFile提供的接口写入到磁盘中
-        for(auto& buffer:buffersToWrite) output.append(buffer->data(),buffer->length());
+        writeBuffers(buffersToWrite, output);
+        if(!rings.empty()) harvestStaging(rings, *mergeBuffer, output);
+        if(dropped > 0) reportDropped(dropped, policy, output);
 
         if(buffersToWrite.size() > 2) buffersToWrite.resize(2);
 
@@ -69,5 +297,19 @@ void AsyncLogging::threadFunc(){
         buffersToWrite.clear(); // 清空后端缓冲队列
         output.flush();         // 清空文件夹缓冲区
     }
+    // 退出前把最后一轮之后写入的日志也落盘
+    {
+        std::lock_guard<std::mutex> lg(mutex_);
+        writeBuffers(buffers_, output);
+        buffers_.clear();
+        output.append(currentBuffer_->data(),currentBuffer_->length());
+        currentBuffer_->reset();
+        rings = rings_;
+        for(auto& ring : rings) ring->beginRead();
+        dropped_ += stagingDropped_.exchange(0);
+        if(dropped_ > 0) reportDropped(dropped_, overflowPolicy_, output);
+        dropped_ = 0;
+    }
+    if(!rings.empty()) harvestStaging(rings, *mergeBuffer, output);
     output.flush();//确保清空
-}
\ No newline at end of file
+}
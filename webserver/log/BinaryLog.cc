@@ -0,0 +1,65 @@
+#include <mutex>
+#include <vector>
+
+#include "BinaryLog.h"
+
+namespace
+{
+    // 已注册调用点的定义记录 下标+1就是调用点编号
+    // g_sitesMutex只保护g_siteRecords 持有时不做任何输出: 日志后端滚动文件时在dictionary()里要拿它,
+    // 而输出可能阻塞等待后端(AsyncLogging::kBlock), 持有它输出就会互相等待
+    std::mutex g_sitesMutex;
+    std::vector<std::string> g_siteRecords;
+    // 串行化注册 定义记录输出完才发布编号 其他线程首次使用同一个调用点时在这里等待
+    std::mutex g_registerMutex;
+
+    void appendField(std::string* record, const char* data, size_t len){
+        if(len > UINT16_MAX) len = UINT16_MAX;
+        const uint16_t n = static_cast<uint16_t>(len);
+        record->append(reinterpret_cast<const char*>(&n), 2);
+        record->append(data, len);
+    }
+    template<typename T>
+    void appendFixed(std::string* record, T value){
+        record->append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+}
+
+namespace BinaryLog
+{
+    std::string dictionary(){
+        std::lock_guard<std::mutex> lock(g_sitesMutex);
+        std::string all;
+        for(const auto& record : g_siteRecords) all += record;
+        return all;
+    }
+
+    uint32_t Site::registerSite(const char* signature){
+        std::lock_guard<std::mutex> registerLock(g_registerMutex);
+        uint32_t id = id_.load(std::memory_order_relaxed);
+        if(id != 0) return id; // 其他线程刚注册完
+
+        std::string record;
+        record.append(kHeaderSize, '\0');
+        appendFixed<uint32_t>(&record, 0); // 编号 登记时填写
+        appendFixed<uint8_t>(&record, static_cast<uint8_t>(level_));
+        appendFixed<uint32_t>(&record, static_cast<uint32_t>(line_));
+        const char* slash = ::strrchr(file_, '/');
+        const char* base = slash ? slash + 1 : file_;
+        appendField(&record, base, ::strlen(base));
+        appendField(&record, format_, ::strlen(format_));
+        appendField(&record, signature, ::strlen(signature));
+        fillHeader(&record[0], kSiteRecord, static_cast<int>(record.size()));
+        {
+            std::lock_guard<std::mutex> lock(g_sitesMutex);
+            id = static_cast<uint32_t>(g_siteRecords.size() + 1);
+            ::memcpy(&record[kHeaderSize], &id, sizeof(id));
+            g_siteRecords.push_back(record);
+        }
+        // 第一次使用时在日志流中就地输出定义 发布编号之前输出 保证它写在所有线程的本调用点日志记录之前
+        // 这时候已经不持有g_sitesMutex 后端滚动文件时可以照常取dictionary()
+        Logger::output(record.data(), static_cast<int>(record.size()));
+        id_.store(id, std::memory_order_release);
+        return id;
+    }
+}
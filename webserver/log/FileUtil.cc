@@ -1,16 +1,44 @@
 #include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <vector>
 #include "FileUtil.h"
 //以追加模式打开一个文件，并且设置其执行时关闭
-FileUtil::FileUtil(std::string& file_name):file_(::fopen(file_name.c_str(),"ae")), writtenBytes_(0){
-    // 使用 setbuffer 为该文件流设置一个更大的空间缓冲区（默认的只有几KB），减少系统io的次数
-    ::setbuffer(file_,buffer_,sizeof(buffer_));
+FileUtil::FileUtil(std::string& file_name, bool direct):file_(nullptr), fd_(-1), writtenBytes_(0){
+    if(direct){
+        fd_ = ::open(file_name.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    }else{
+        file_ = ::fopen(file_name.c_str(),"ae");
+        // 使用 setbuffer 为该文件流设置一个更大的空间缓冲区（默认的只有几KB），减少系统io的次数
+        if(file_){
+            ::setbuffer(file_,buffer_,sizeof(buffer_));
+            fd_ = ::fileno(file_);
+        }
+    }
+    if(fd_ < 0){
+        fprintf(stderr,"FileUtil open %s failed %s\n", file_name.c_str(), strerror(errno));
+        return;
+    }
+    // 同一秒内重启会追加到已有的文件 滚动按文件的实际大小计算
+    struct stat st;
+    if(::fstat(fd_, &st) == 0) writtenBytes_ = st.st_size;
 }
 FileUtil::~FileUtil(){
     if(file_) ::fclose(file_);
+    else if(fd_ >= 0) ::close(fd_);
 }
 
 //向文件写入数据
 void FileUtil::append(const char* data,size_t len){
+    if(file_ == nullptr){
+        struct iovec iov = {const_cast<char*>(data), len};
+        appendv(&iov, 1);
+        return;
+    }
     size_t writen = 0;
     while(writen != len){
         size_t remain = len - writen; //剩余需要写入的长度
@@ -32,11 +60,52 @@ void FileUtil::append(const char* data,size_t len){
     writtenBytes_ += writen;
 }
 
+void FileUtil::appendv(const struct iovec* iov, int count){
+    if(file_){
+        for(int i = 0; i < count; ++i) append(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+        return;
+    }
+    if(fd_ < 0) return;
+    // 部分写入时要调整iovec 在副本上操作
+    std::vector<struct iovec> pending(iov, iov + count);
+    size_t i = 0;
+    while(i < pending.size()){
+        const int n = static_cast<int>(std::min<size_t>(pending.size() - i, IOV_MAX));
+        ssize_t written = ::writev(fd_, &pending[i], n);
+        if(written < 0){
+            if(errno == EINTR) continue;
+            fprintf(stderr,"FileUtil::appendv() failed %s\n", strerror(errno));
+            break;
+        }
+        writtenBytes_ += written;
+        size_t left = static_cast<size_t>(written);
+        while(i < pending.size() && left >= pending[i].iov_len){
+            left -= pending[i].iov_len;
+            ++i;
+        }
+        if(left > 0){
+            pending[i].iov_base = static_cast<char*>(pending[i].iov_base) + left;
+            pending[i].iov_len -= left;
+        }
+    }
+}
+
 void FileUtil::flush(){
-    ::fflush(file_);
+    if(file_) ::fflush(file_);
+}
+
+void FileUtil::sync(){
+    flush();
+    if(fd_ >= 0) ::fdatasync(fd_);
+}
+
+void FileUtil::dropCache(){
+    // 只有干净的页才能被丢掉 先写回
+    sync();
+    if(fd_ >= 0) ::posix_fadvise(fd_, 0, 0, POSIX_FADV_DONTNEED);
 }
 //write逻辑
 size_t FileUtil::write(const char* data,size_t len){
     // 没有选择线程安全的fwrite()为性能考虑。
    return  ::fwrite_unlocked(data, 1, len, file_);//每个数据项的大小（以字节为单位）。这里设置为1字节，是最常见的用法
-}
\ No newline at end of file
+}
@@ -0,0 +1,156 @@
+#include "LogCompressor.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <zlib.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    // glibc没有封装ioprio_set
+    const int kIoprioClassIdle = 3;
+    const int kIoprioClassShift = 13;
+    const int kIoprioWhoProcess = 1;
+
+    bool endsWith(const std::string& s, const char* suffix){
+        const size_t n = ::strlen(suffix);
+        return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+    }
+}
+
+LogCompressor::LogCompressor(const std::string& basename, int level, off_t retainBytes)
+    : basename_(basename),
+    level_(std::min(level, 9)),
+    retainBytes_(retainBytes),
+    thread_(std::bind(&LogCompressor::threadFunc, this), "LogCompressor"),
+    running_(false)
+{
+}
+
+LogCompressor::~LogCompressor(){
+    if(running_) stop();
+}
+
+void LogCompressor::start(){
+    running_ = true;
+    thread_.start();
+}
+
+void LogCompressor::stop(){
+    {
+        std::lock_guard<std::mutex> lg(mutex_);
+        running_ = false;
+        cond_.notify_one();
+    }
+    thread_.join();
+}
+
+void LogCompressor::enqueue(const std::string& filename){
+    std::lock_guard<std::mutex> lg(mutex_);
+    queue_.push_back(filename);
+    cond_.notify_one();
+}
+
+void LogCompressor::threadFunc(){
+    // 对Linux线程而言nice值和IO优先级都是按线程生效的
+    ::setpriority(PRIO_PROCESS, 0, 19);
+    ::syscall(SYS_ioprio_set, kIoprioWhoProcess, 0, kIoprioClassIdle << kIoprioClassShift);
+    for(;;){
+        std::string filename;
+        {
+            std::unique_lock<std::mutex> lg(mutex_);
+            cond_.wait(lg, [this](){return !queue_.empty() || !running_;});
+            if(queue_.empty()) break;
+            filename = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        if(level_ > 0 && compress(filename)) ::unlink(filename.c_str());
+        if(retainBytes_ > 0) enforceRetention();
+    }
+}
+
+bool LogCompressor::compress(const std::string& filename){
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        // 可能已经被清理掉了
+        if(errno != ENOENT) fprintf(stderr, "LogCompressor open %s failed %s\n", filename.c_str(), strerror(errno));
+        return false;
+    }
+    const std::string target = filename + ".gz";
+    const std::string tmp = target + ".tmp";
+    char mode[8];
+    snprintf(mode, sizeof(mode), "wb%d", level_);
+    gzFile gz = ::gzopen(tmp.c_str(), mode);
+    if(gz == nullptr){
+        fprintf(stderr, "LogCompressor gzopen %s failed\n", tmp.c_str());
+        ::close(fd);
+        return false;
+    }
+    ::gzbuffer(gz, 128 * 1024);
+    std::unique_ptr<char[]> buf(new char[128 * 1024]);
+    bool ok = true;
+    for(;;){
+        ssize_t n = ::read(fd, buf.get(), 128 * 1024);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0){
+            ok = n == 0;
+            break;
+        }
+        if(::gzwrite(gz, buf.get(), static_cast<unsigned>(n)) != n){
+            ok = false;
+            break;
+        }
+    }
+    ::close(fd);
+    if(::gzclose(gz) != Z_OK) ok = false;
+    if(!ok || ::rename(tmp.c_str(), target.c_str()) < 0){
+        fprintf(stderr, "LogCompressor compress %s failed\n", filename.c_str());
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+void LogCompressor::enforceRetention(){
+    const size_t slash = basename_.rfind('/');
+    const std::string dir = slash == std::string::npos ? "." : basename_.substr(0, slash + 1);
+    const std::string prefix = (slash == std::string::npos ? basename_ : basename_.substr(slash + 1)) + ".";
+    DIR* d = ::opendir(dir.c_str());
+    if(d == nullptr) return;
+    struct LogEntry{
+        std::string key;  // 去掉.gz后的文件名 其中的时间戳决定新旧
+        std::string path;
+        off_t size;
+    };
+    std::vector<LogEntry> entries;
+    while(struct dirent* ent = ::readdir(d)){
+        std::string name = ent->d_name;
+        if(name.compare(0, prefix.size(), prefix) != 0) continue;
+        std::string key = name;
+        if(endsWith(key, ".gz")) key.resize(key.size() - 3);
+        if(!endsWith(key, ".log")) continue;
+        std::string path = slash == std::string::npos ? name : dir + name;
+        struct stat st;
+        if(::stat(path.c_str(), &st) < 0) continue;
+        entries.push_back(LogEntry{key, path, st.st_size});
+    }
+    ::closedir(d);
+    if(entries.size() <= 1) return;
+    std::sort(entries.begin(), entries.end(), [](const LogEntry& a, const LogEntry& b){return a.key < b.key;});
+    off_t total = 0;
+    for(auto& entry : entries) total += entry.size;
+    // 最后一个是正在写的文件 不删
+    for(size_t i = 0; i + 1 < entries.size() && total > retainBytes_; ++i){
+        if(entries[i].key == entries.back().key) break;
+        if(::unlink(entries[i].path.c_str()) == 0) total -= entries[i].size;
+    }
+}
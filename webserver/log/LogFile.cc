@@ -6,9 +6,15 @@ LogFile::LogFile(const std::string &basename,
                                            rollsize_(rollsize),
                                            flushInterval_(flushInterval),
                                            checkEveryN_(checkEveryN),
+                                           count_(0),
                                            startOfPeriod_(0),
                                            lastRoll_(0),
-                                           lastFlush_(0){
+                                           lastFlush_(0),
+                                           direct_(false),
+                                           syncPolicy_(kSyncNone),
+                                           syncBytes_(0),
+                                           unsyncedBytes_(0),
+                                           dropRolledPages_(false){
     // 重新启动时，可能没有log文件，因此在构建logFile对象，直接调用rollfile()创建一个新的log文件
     rollFile();
 }
@@ -17,8 +23,34 @@ void LogFile::append(const char* data,int len){
     std::lock_guard<std::mutex> lg(mutex_);//lock_guard保证构造时自动上锁，析构时自动解锁
     appendInlock(data,len);
 }
+void LogFile::appendv(const struct iovec* iov, int count){
+    std::lock_guard<std::mutex> lg(mutex_);
+    off_t len = 0;
+    for(int i = 0; i < count; ++i) len += iov[i].iov_len;
+    file_->appendv(iov, count);
+    afterAppendInlock(len);
+}
 void LogFile::flush(){
+    if(syncPolicy_ == kSyncEveryFlush && unsyncedBytes_ > 0){
+        file_->sync();
+        unsyncedBytes_ = 0;
+    }else{
+        file_->flush();
+    }
+}
+void LogFile::setFileHeader(std::function<std::string()> header){
+    std::lock_guard<std::mutex> lg(mutex_);
+    header_ = std::move(header);
+    // 第一个文件在构造函数里就打开了 那时还没有header_
+    writeHeaderInlock();
+}
+void LogFile::setDirectWrite(bool on){
+    std::lock_guard<std::mutex> lg(mutex_);
+    if(on == direct_) return;
+    direct_ = on;
+    // 以追加方式重新打开同一个文件 已写的内容和大小都保留
     file_->flush();
+    file_.reset(new FileUtil(filename_, direct_));
 }
 // 滚动日志
 bool LogFile::rollFile(){
@@ -30,8 +62,18 @@ bool LogFile::rollFile(){
         lastRoll_ = now;
         startOfPeriod_ = start;
 
+        // 旧文件不会再写 按策略落盘或者丢掉页缓存
+        if(file_){
+            if(dropRolledPages_) file_->dropCache();
+            else if(syncPolicy_ != kSyncNone && unsyncedBytes_ > 0) file_->sync();
+        }
+        unsyncedBytes_ = 0;
         // 创建新日志文件
-        file_.reset(new FileUtil(filename));
+        std::string closed = std::move(filename_);
+        filename_ = filename;
+        file_.reset(new FileUtil(filename_, direct_));
+        if(rollCallback_ && !closed.empty()) rollCallback_(closed);
+        writeHeaderInlock();
         return true;
     }
     return false;
@@ -53,11 +95,26 @@ std::string LogFile::getLogFileName(const std::string& basename,time_t* now){
     return filename;
 }
 
+void LogFile::writeHeaderInlock(){
+    if(!header_) return;
+    std::string header = header_();
+    if(!header.empty()) file_->append(header.data(), header.size());
+}
+
 void LogFile::appendInlock(const char* data,int len){
     file_->append(data,len);
+    afterAppendInlock(len);
+}
+
+void LogFile::afterAppendInlock(off_t len){
     time_t now = time(NULL);
     ++count_;
 
+    unsyncedBytes_ += len;
+    if(syncPolicy_ == kSyncEveryBytes && unsyncedBytes_ >= syncBytes_){
+        file_->sync();
+        unsyncedBytes_ = 0;
+    }
     // 1. 判断是否需要滚动日志
     if(file_->writtenBytes() > rollsize_){
         rollFile();
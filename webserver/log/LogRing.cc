@@ -0,0 +1,86 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+#include "LogRing.h"
+
+const uint32_t LogRing::kVersion;
+const uint32_t LogRing::kDataOffset;
+
+static_assert(sizeof(LogRing::Header) <= LogRing::kDataOffset, "LogRing header must fit in the first page");
+
+LogRing::LogRing(const std::string& path, size_t capacity)
+    : fd_(-1)
+    , capacity_((capacity + kDataOffset - 1) / kDataOffset * kDataOffset)
+    , mappedSize_(kDataOffset + capacity_)
+    , base_(nullptr)
+    , header_(nullptr)
+    , data_(nullptr)
+{
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if(fd_ < 0){
+        fprintf(stderr, "LogRing open %s failed: %s\n", path.c_str(), strerror(errno));
+        return;
+    }
+    struct stat st;
+    bool reuse = ::fstat(fd_, &st) == 0 && static_cast<size_t>(st.st_size) == mappedSize_;
+    if(!reuse && ::ftruncate(fd_, static_cast<off_t>(mappedSize_)) < 0){
+        fprintf(stderr, "LogRing ftruncate %s failed: %s\n", path.c_str(), strerror(errno));
+        return;
+    }
+    // ftruncate出来的文件是稀疏的 磁盘满时第一次写到没分配的页会SIGBUS, 先把整个文件的块分配好
+    int err = ::posix_fallocate(fd_, 0, static_cast<off_t>(mappedSize_));
+    if(err != 0){
+        fprintf(stderr, "LogRing fallocate %s failed: %s\n", path.c_str(), strerror(err));
+        return;
+    }
+    // MAP_POPULATE 提前建立映射 写日志时不再缺页
+    void* p = ::mmap(nullptr, mappedSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, 0);
+    if(p == MAP_FAILED){
+        fprintf(stderr, "LogRing mmap %s failed: %s\n", path.c_str(), strerror(errno));
+        return;
+    }
+    base_ = static_cast<char*>(p);
+    Header* header = reinterpret_cast<Header*>(base_);
+    // 同样容量的旧环接着写 否则重新初始化
+    if(!(reuse && ::memcmp(header->magic, kMagic, sizeof(kMagic)) == 0 && header->version == kVersion
+         && header->dataOffset == kDataOffset && header->capacity == capacity_)){
+        ::memset(base_, 0, kDataOffset);
+        ::memcpy(header->magic, kMagic, sizeof(kMagic));
+        header->version = kVersion;
+        header->dataOffset = kDataOffset;
+        header->capacity = capacity_;
+        header->writePos.store(0, std::memory_order_relaxed);
+    }
+    header_ = header;
+    data_ = base_ + kDataOffset;
+}
+
+LogRing::~LogRing(){
+    if(base_) ::munmap(base_, mappedSize_);
+    if(fd_ >= 0) ::close(fd_);
+}
+
+void LogRing::append(const char* data, int len){
+    if(header_ == nullptr || len <= 0) return;
+    size_t n = static_cast<size_t>(len);
+    // 比整个环还大时只保留末尾
+    if(n > capacity_){
+        data += n - capacity_;
+        n = capacity_;
+    }
+    const uint64_t pos = header_->writePos.fetch_add(n, std::memory_order_relaxed);
+    const size_t offset = static_cast<size_t>(pos % capacity_);
+    const size_t first = std::min(n, capacity_ - offset);
+    ::memcpy(data_ + offset, data, first);
+    if(first < n) ::memcpy(data_, data + first, n - first);
+}
+
+void LogRing::flush(){
+    if(base_) ::msync(base_, mappedSize_, MS_ASYNC);
+}
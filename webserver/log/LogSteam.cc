@@ -1,25 +1,60 @@
 #include "LogStream.h"
-#include <algorithm>
+#include <charconv>
+#include <type_traits>
 
-static const char digits[] = "9876543210123456789";//-123 % 10 = -3,所以负数区域也有对应的1-9
+// 00~99两位一组的查表 每次除以100产生两位数字 除法次数减半
+static const char kDigitPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+static const char kHexDigits[] = "0123456789abcdef";
 
 template <typename T>
 void LogStream::formatInteger(T num){
     if(buffer_.avail() >= kMaxNumberSize){
-        char* start = buffer_.current();
-        char* cur = start;
-        static const char* zero = digits + 9;//digits + 9正好指向中间的'0'字符
+        using Unsigned = typename std::make_unsigned<T>::type;
         bool negative = (num<0);//判断是否为负数
-        do{//do-while：至少执行一次循环体
-            int remainder = static_cast<int>(num % 10);
-            (*cur++) = zero[remainder];//赋值后cur再++，zero[remainder] 是语法糖，编译器会转换为 *(zero + remainder)
-            num /= 10;
+        // 先转成无符号再取反 最小的负数也不会溢出
+        Unsigned value = negative ? static_cast<Unsigned>(0) - static_cast<Unsigned>(num) : static_cast<Unsigned>(num);
+        // 从后往前写进临时缓冲 不需要再reverse
+        char buf[kMaxNumberSize];
+        char* end = buf + sizeof(buf);
+        char* cur = end;
+        while(value >= 100){
+            const unsigned index = static_cast<unsigned>(value % 100) * 2;
+            value /= 100;
+            cur -= 2;
+            memcpy(cur, kDigitPairs + index, 2);
+        }
+        if(value < 10) *--cur = static_cast<char>('0' + value);
+        else{
+            cur -= 2;
+            memcpy(cur, kDigitPairs + value * 2, 2);
+        }
+        if(negative) *--cur = '-';
+        buffer_.append(cur, end - cur);
+    }
+}
+
+void LogStream::formatHex(uintptr_t num){
+    if(buffer_.avail() >= kMaxNumberSize){
+        char buf[kMaxNumberSize];
+        char* end = buf + sizeof(buf);
+        char* cur = end;
+        do{
+            *--cur = kHexDigits[num & 0xf];
+            num >>= 4;
         }while(num != 0);
-        if(negative) *cur++ = '-';
-        *cur = '\0';
-        std::reverse(start,cur);//上面组成的字符串是和原本刚好反过来的
-        int length = static_cast<int>(cur-start);
-        buffer_.add(length);
+        *--cur = 'x';
+        *--cur = '0';
+        buffer_.append(cur, end - cur);
     }
 }
 // 重载输出流运算符<<，用于将布尔值写入缓冲区
@@ -32,6 +67,11 @@ LogStream& LogStream::operator<<(short number){
     formatInteger(number);
     return *this;
 }
+// 无符号短整型
+LogStream& LogStream::operator<<(unsigned short number){
+    formatInteger(number);
+    return *this;
+}
 // 整型
 LogStream& LogStream::operator<<(int number){
     formatInteger(number);
@@ -69,9 +109,21 @@ LogStream& LogStream::operator<<(float number){
 }
 // 双精度浮点型
 LogStream& LogStream::operator<<(double number){
-    char buffer[32];
-    snprintf(buffer,sizeof(buffer),"%.12g",number);//%g：智能选择%f(定点)或%e(科学计数法)格式
-    buffer_.append(buffer,strlen(buffer));
+    if(buffer_.avail() >= kMaxNumberSize){
+        // to_chars不带精度时输出能精确还原该double的最短表示
+        std::to_chars_result result = std::to_chars(buffer_.current(), buffer_.current() + kMaxNumberSize, number);
+        buffer_.add(result.ptr - buffer_.current());
+    }
+    return *this;
+}
+// 指针
+LogStream& LogStream::operator<<(const void* p){
+    formatHex(reinterpret_cast<uintptr_t>(p));
+    return *this;
+}
+// 十六进制整数
+LogStream& LogStream::operator<<(const HexTemplate& h){
+    formatHex(static_cast<uintptr_t>(h.value_));
     return *this;
 }
 // 字符型
@@ -0,0 +1,138 @@
+/**
+ * 日志吞吐和延迟测试
+ * 用法: log_bench [-t 线程数] [-n 每线程条数] [-s 消息字节数] [-m stdout|file|both] [-d 目录] [-r 滚动字节数] [-S 暂存环字节数]
+ * 每个线程循环执行LOG_INFO 记录每次调用的耗时, 输出各分位延迟和每秒行数
+ *   stdout: Logger默认的输出函数(fwrite到stdout) 测试时请把标准输出重定向 如 > /dev/null
+ *   file:   AsyncLogging + LogFile写到 目录/log_bench.*.log, 溢出策略为kBlock 所有日志都会落盘
+ * 结果写到标准错误
+ **/
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AsyncLogging.h"
+#include "Logger.h"
+
+namespace
+{
+    struct Options{
+        int threads = 4;
+        long messages = 200000;
+        int size = 100;
+        std::string mode = "both";
+        std::string dir = "/tmp";
+        off_t rollSize = 1L << 30;
+        size_t staging = 0;
+    };
+
+    AsyncLogging* g_asyncLog = nullptr;
+
+    void asyncOutput(const char* msg, int len){
+        g_asyncLog->append(msg, len);
+    }
+
+    int64_t nowNanos(){
+        struct timespec ts;
+        ::clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    // 每个线程写messages条 每条的耗时记在latencies里
+    void producer(int id, const Options& options, const std::string& payload, std::vector<uint32_t>* latencies){
+        latencies->resize(options.messages);
+        for(long i = 0; i < options.messages; ++i){
+            const int64_t start = nowNanos();
+            LOG_INFO << "bench thread " << id << " seq " << i << ' ' << payload;
+            const int64_t cost = nowNanos() - start;
+            (*latencies)[i] = static_cast<uint32_t>(std::min<int64_t>(cost, UINT32_MAX));
+        }
+    }
+
+    // 返回所有线程写完所用的秒数
+    double runProducers(const Options& options, std::vector<uint32_t>* all){
+        const std::string payload(options.size, 'x');
+        std::vector<std::vector<uint32_t>> latencies(options.threads);
+        std::vector<std::thread> threads;
+        const int64_t start = nowNanos();
+        for(int i = 0; i < options.threads; ++i){
+            threads.emplace_back(producer, i, std::cref(options), std::cref(payload), &latencies[i]);
+        }
+        for(auto& thread : threads) thread.join();
+        const double seconds = static_cast<double>(nowNanos() - start) / 1e9;
+        all->clear();
+        for(auto& v : latencies) all->insert(all->end(), v.begin(), v.end());
+        return seconds;
+    }
+
+    void report(const char* name, const Options& options, std::vector<uint32_t>& latencies, double frontSeconds, double totalSeconds){
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&latencies](double p){
+            size_t index = static_cast<size_t>(p * static_cast<double>(latencies.size() - 1));
+            return latencies[index];
+        };
+        const double lines = static_cast<double>(latencies.size());
+        fprintf(stderr, "%-6s threads=%d lines=%.0f size=%d  front-end %.0f lines/s  end-to-end %.0f lines/s\n",
+                name, options.threads, lines, options.size, lines / frontSeconds, lines / totalSeconds);
+        fprintf(stderr, "       latency ns: p50 %u  p90 %u  p99 %u  p99.9 %u  p99.99 %u  max %u\n",
+                percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999), percentile(0.9999), latencies.back());
+    }
+
+    void benchStdout(const Options& options){
+        std::vector<uint32_t> latencies;
+        const double seconds = runProducers(options, &latencies);
+        const int64_t start = nowNanos();
+        fflush(stdout);
+        const double flushSeconds = static_cast<double>(nowNanos() - start) / 1e9;
+        report("stdout", options, latencies, seconds, seconds + flushSeconds);
+    }
+
+    void benchFile(const Options& options){
+        ::mkdir(options.dir.c_str(), 0755);
+        AsyncLogging log(options.dir + "/log_bench", options.rollSize);
+        log.setOverflowPolicy(AsyncLogging::kBlock);
+        log.setThreadStaging(options.staging);
+        g_asyncLog = &log;
+        Logger::setOutput(asyncOutput);
+        log.start();
+        std::vector<uint32_t> latencies;
+        const int64_t start = nowNanos();
+        const double seconds = runProducers(options, &latencies);
+        log.stop(); // 等后端全部写完
+        const double totalSeconds = static_cast<double>(nowNanos() - start) / 1e9;
+        report("file", options, latencies, seconds, totalSeconds);
+    }
+}
+
+int main(int argc, char* argv[]){
+    Options options;
+    int opt;
+    while((opt = ::getopt(argc, argv, "t:n:s:m:d:r:S:h")) != -1){
+        switch(opt){
+        case 't': options.threads = std::max(1, atoi(optarg)); break;
+        case 'n': options.messages = std::max(1L, atol(optarg)); break;
+        case 's': options.size = std::max(0, atoi(optarg)); break;
+        case 'm': options.mode = optarg; break;
+        case 'd': options.dir = optarg; break;
+        case 'r': options.rollSize = atol(optarg); break;
+        case 'S': options.staging = strtoul(optarg, nullptr, 10); break;
+        default:
+            fprintf(stderr, "usage: %s [-t threads] [-n messages per thread] [-s message bytes] [-m stdout|file|both] [-d dir] [-r roll bytes] [-S staging bytes]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if(options.mode != "stdout" && options.mode != "file" && options.mode != "both"){
+        fprintf(stderr, "log_bench: unknown mode %s\n", options.mode.c_str());
+        return 1;
+    }
+    // stdout要在替换输出函数之前测
+    if(options.mode != "file") benchStdout(options);
+    if(options.mode != "stdout") benchFile(options);
+    return 0;
+}
@@ -0,0 +1,237 @@
+/**
+ * 二进制日志解码工具
+ * 用法: log_decode [日志文件...]  不给文件时读标准输入
+ * 文本行原样输出, LOG_BIN写入的记录按调用点定义还原成与LOG_XXX相同格式的文本行
+ **/
+#include <stdio.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <charconv>
+#include <string>
+#include <unordered_map>
+
+#include "BinaryLog.h"
+
+namespace
+{
+    const char* kLevelNames[] = {"TRACE ", "DEBUG ", "INFO  ", "WARN  ", "ERROR ", "FATAL "};
+
+    struct SiteInfo{
+        int level;
+        uint32_t line;
+        std::string file;
+        std::string format;
+        std::string signature;
+    };
+
+    // 按顺序读取记录体中的字段 越界时置ok=false
+    class Reader{
+    public:
+        Reader(const char* data, size_t len) : cur_(data), end_(data + len), ok_(true){}
+
+        template<typename T>
+        T fixed(){
+            T value{};
+            if(static_cast<size_t>(end_ - cur_) < sizeof(T)){
+                ok_ = false;
+                return value;
+            }
+            ::memcpy(&value, cur_, sizeof(T));
+            cur_ += sizeof(T);
+            return value;
+        }
+        std::string field(){
+            uint16_t n = fixed<uint16_t>();
+            if(!ok_ || static_cast<size_t>(end_ - cur_) < n){
+                ok_ = false;
+                return std::string();
+            }
+            std::string value(cur_, n);
+            cur_ += n;
+            return value;
+        }
+        bool ok() const {return ok_;}
+    private:
+        const char* cur_;
+        const char* end_;
+        bool ok_;
+    };
+
+    class Decoder{
+    public:
+        explicit Decoder(FILE* out) : out_(out), lastSecond_(-1){}
+
+        // 解码一段完整的日志内容 返回处理掉的字节数 末尾不完整的记录留给调用者
+        size_t decode(const char* data, size_t len, bool eof){
+            size_t pos = 0;
+            while(pos < len){
+                if(data[pos] == BinaryLog::kMagic){
+                    if(len - pos < static_cast<size_t>(BinaryLog::kHeaderSize)) break;
+                    uint16_t recordLen;
+                    ::memcpy(&recordLen, data + pos + 2, 2);
+                    if(recordLen < BinaryLog::kHeaderSize){
+                        ++pos; // 损坏的记录头 跳过这个字节继续找
+                        continue;
+                    }
+                    if(len - pos < recordLen) break;
+                    const char type = data[pos + 1];
+                    const char* body = data + pos + BinaryLog::kHeaderSize;
+                    const size_t bodyLen = recordLen - BinaryLog::kHeaderSize;
+                    if(type == BinaryLog::kSiteRecord) defineSite(body, bodyLen);
+                    else if(type == BinaryLog::kLogRecord) printRecord(body, bodyLen);
+                    pos += recordLen;
+                }else{
+                    const void* nl = ::memchr(data + pos, '\n', len - pos);
+                    if(nl == nullptr && !eof) break;
+                    size_t lineEnd = nl ? static_cast<const char*>(nl) - data + 1 : len;
+                    ::fwrite(data + pos, 1, lineEnd - pos, out_);
+                    pos = lineEnd;
+                }
+            }
+            return eof ? len : pos;
+        }
+    private:
+        void defineSite(const char* body, size_t len){
+            Reader reader(body, len);
+            uint32_t id = reader.fixed<uint32_t>();
+            SiteInfo site;
+            site.level = reader.fixed<uint8_t>();
+            site.line = reader.fixed<uint32_t>();
+            site.file = reader.field();
+            site.format = reader.field();
+            site.signature = reader.field();
+            if(reader.ok()) sites_[id] = std::move(site);
+        }
+
+        void printRecord(const char* body, size_t len){
+            Reader reader(body, len);
+            uint32_t id = reader.fixed<uint32_t>();
+            int64_t micros = reader.fixed<int64_t>();
+            auto it = sites_.find(id);
+            line_.clear();
+            appendTime(micros);
+            if(it == sites_.end()){
+                line_ += "?????? <unknown binary log site " + std::to_string(id) + ">\n";
+                ::fwrite(line_.data(), 1, line_.size(), out_);
+                return;
+            }
+            const SiteInfo& site = it->second;
+            line_ += site.level >= 0 && site.level < 6 ? kLevelNames[site.level] : "?????? ";
+            // 依次把{}替换成参数 多出来的参数追加在末尾
+            size_t argIndex = 0;
+            const std::string& format = site.format;
+            for(size_t i = 0; i < format.size(); ++i){
+                if(format[i] == '{' && i + 1 < format.size() && format[i + 1] == '}' && argIndex < site.signature.size()){
+                    appendArg(reader, site.signature[argIndex++]);
+                    ++i;
+                }else{
+                    line_ += format[i];
+                }
+            }
+            while(argIndex < site.signature.size()){
+                line_ += ' ';
+                appendArg(reader, site.signature[argIndex++]);
+            }
+            if(!reader.ok()) line_ += " <truncated>";
+            line_ += " - " + site.file + ':' + std::to_string(site.line) + '\n';
+            ::fwrite(line_.data(), 1, line_.size(), out_);
+        }
+
+        void appendArg(Reader& reader, char code){
+            char buf[64];
+            switch(code){
+            case BinaryLog::kInt:{
+                std::to_chars_result r = std::to_chars(buf, buf + sizeof(buf), reader.fixed<int64_t>());
+                line_.append(buf, r.ptr - buf);
+                break;
+            }
+            case BinaryLog::kUint:{
+                std::to_chars_result r = std::to_chars(buf, buf + sizeof(buf), reader.fixed<uint64_t>());
+                line_.append(buf, r.ptr - buf);
+                break;
+            }
+            case BinaryLog::kDouble:{
+                std::to_chars_result r = std::to_chars(buf, buf + sizeof(buf), reader.fixed<double>());
+                line_.append(buf, r.ptr - buf);
+                break;
+            }
+            case BinaryLog::kPointer:{
+                std::to_chars_result r = std::to_chars(buf, buf + sizeof(buf), reader.fixed<uint64_t>(), 16);
+                line_ += "0x";
+                line_.append(buf, r.ptr - buf);
+                break;
+            }
+            case BinaryLog::kChar:
+                line_ += reader.fixed<char>();
+                break;
+            case BinaryLog::kBool:
+                line_ += reader.fixed<uint8_t>() ? "true" : "false";
+                break;
+            case BinaryLog::kString:
+                line_ += reader.field();
+                break;
+            default:
+                line_ += "<?>";
+                break;
+            }
+        }
+
+        void appendTime(int64_t micros){
+            time_t seconds = static_cast<time_t>(micros / 1000000);
+            if(seconds != lastSecond_){
+                struct tm tm_time;
+                localtime_r(&seconds, &tm_time);
+                snprintf(timebuf_, sizeof(timebuf_), "%4d/%02d/%02d %02d:%02d:%02d",
+                    tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
+                    tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec);
+                lastSecond_ = seconds;
+            }
+            char buf[16];
+            snprintf(buf, sizeof(buf), ".%06d ", static_cast<int>(micros % 1000000));
+            line_ += timebuf_;
+            line_ += buf;
+        }
+
+        FILE* out_;
+        std::unordered_map<uint32_t, SiteInfo> sites_;
+        std::string line_;
+        time_t lastSecond_;
+        char timebuf_[64]; // 按各字段int的最大宽度留够 避免格式化截断
+    };
+
+    // 分块读取 块尾不完整的记录留到下一块
+    void decodeFile(FILE* in, Decoder& decoder){
+        std::string pending;
+        char buf[64 * 1024];
+        size_t n;
+        while((n = ::fread(buf, 1, sizeof(buf), in)) > 0){
+            pending.append(buf, n);
+            size_t used = decoder.decode(pending.data(), pending.size(), false);
+            pending.erase(0, used);
+        }
+        decoder.decode(pending.data(), pending.size(), true);
+    }
+}
+
+int main(int argc, char* argv[]){
+    Decoder decoder(stdout);
+    if(argc < 2){
+        decodeFile(stdin, decoder);
+        return 0;
+    }
+    int ret = 0;
+    // 多个文件按给出的顺序解码 调用点定义在文件之间共享
+    for(int i = 1; i < argc; ++i){
+        FILE* in = ::fopen(argv[i], "rb");
+        if(in == nullptr){
+            fprintf(stderr, "log_decode: cannot open %s: %s\n", argv[i], strerror(errno));
+            ret = 1;
+            continue;
+        }
+        decodeFile(in, decoder);
+        ::fclose(in);
+    }
+    return ret;
+}
@@ -0,0 +1,69 @@
+/**
+ * 取出LogRing环文件中的日志
+ * 用法: log_ringdump <环文件> [最多输出的字节数]
+ * 按写入顺序输出环中仍保留的内容, 环已经绕回时从第一个完整的行开始;
+ * 其中若有LOG_BIN写的二进制记录 可以再交给log_decode解码
+ **/
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+#include "LogRing.h"
+
+int main(int argc, char* argv[]){
+    if(argc < 2){
+        fprintf(stderr, "usage: %s <ring file> [max bytes]\n", argv[0]);
+        return 1;
+    }
+    int fd = ::open(argv[1], O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        fprintf(stderr, "log_ringdump: cannot open %s: %s\n", argv[1], strerror(errno));
+        return 1;
+    }
+    struct stat st;
+    if(::fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < LogRing::kDataOffset){
+        fprintf(stderr, "log_ringdump: %s is not a log ring\n", argv[1]);
+        return 1;
+    }
+    void* p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if(p == MAP_FAILED){
+        fprintf(stderr, "log_ringdump: mmap failed: %s\n", strerror(errno));
+        return 1;
+    }
+    const char* base = static_cast<const char*>(p);
+    const LogRing::Header* header = reinterpret_cast<const LogRing::Header*>(base);
+    if(::memcmp(header->magic, LogRing::kMagic, sizeof(LogRing::kMagic)) != 0 || header->version != LogRing::kVersion
+       || header->dataOffset + header->capacity > static_cast<uint64_t>(st.st_size)){
+        fprintf(stderr, "log_ringdump: %s has a bad header\n", argv[1]);
+        return 1;
+    }
+    const char* data = base + header->dataOffset;
+    const uint64_t capacity = header->capacity;
+    const uint64_t end = header->writePos.load(std::memory_order_acquire);
+    const uint64_t oldest = end > capacity ? end - capacity : 0;
+    uint64_t begin = oldest;
+    if(argc > 2){
+        uint64_t maxBytes = strtoull(argv[2], nullptr, 10);
+        if(end - begin > maxBytes) begin = end - maxBytes;
+    }
+    // 起点落在一行中间时跳到下一行开头; 环已写满时起点的前一个字节已被最新的内容覆盖 不能用来判断
+    if(begin > 0){
+        if(begin == oldest) ++begin;
+        while(begin < end && data[(begin - 1) % capacity] != '\n') ++begin;
+    }
+    while(begin < end){
+        const uint64_t offset = begin % capacity;
+        const uint64_t n = std::min(end - begin, capacity - offset);
+        ::fwrite(data + offset, 1, n, stdout);
+        begin += n;
+    }
+    ::munmap(p, st.st_size);
+    ::close(fd);
+    return 0;
+}
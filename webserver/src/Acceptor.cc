@@ -15,7 +15,7 @@ static int createNonblocking(){
 
 Acceptor::Acceptor(EventLoop* loop,const InetAddress& listenAddr, bool reuseport):loop_(loop),acceptSocket_(createNonblocking()),acceptChannel_(loop,acceptSocket_.fd()),listenning_(false){
     acceptSocket_.setReuseAddr(true);
-    acceptSocket_.setReusePort(true);
+    acceptSocket_.setReusePort(reuseport);
     acceptSocket_.bindAddress(listenAddr);
     // TcpServer::start() => Acceptor.listen() 如果有新用户连接 要执行一个回调(accept => connfd => 打包成Channel => 唤醒subloop)
     // baseloop监听到有事件发生 => acceptChannel_(listenfd) => 执行该回调函数
@@ -42,7 +42,9 @@ void Acceptor::handleRead(){
         else ::close(connfd);
     }
     else{
-        LOG_ERROR<<"accept Err";
-        if(errno == EMFILE) LOG_ERROR<<"sockfd reached limit";
+        // fd耗尽时listenfd持续可读 每次回到loop都会失败 限流避免刷屏
+        int savedErrno = errno;
+        LOG_EVERY_T(ERROR, 1.0)<<"accept Err "<<savedErrno;
+        if(savedErrno == EMFILE) LOG_EVERY_T(ERROR, 1.0)<<"sockfd reached limit";
     }
 }
\ No newline at end of file
@@ -4,6 +4,13 @@
 
 #include "Buffer.h"
 
+char Buffer::s_emptyStorage_[Buffer::kCheapPrepend];
+const size_t Buffer::kMinReadHint;
+const size_t Buffer::kMaxReadHint;
+
+// 每个线程一块溢出缓冲区 只在线程启动时清零一次 不像栈上数组那样每次读都要memset 64KB
+static thread_local char t_extrabuf[65536];
+
 /**
  * 从fd上读取数据 Poller工作在LT模式
  * Buffer缓冲区是有大小的！ 但是从fd上读取数据的时候 却不知道tcp数据的最终大小
@@ -13,7 +20,7 @@
  * 方式追加入buffer_。既考虑了避免系统调用带来开销，又不影响数据的接收。
  **/
 ssize_t Buffer::readFd(int fd, int *saveErrno){
-    char extrabuf[65536] = {0}; // 栈上内存空间 65536/1024 = 64KB
+    char* extrabuf = t_extrabuf; // 线程私有的溢出缓冲区 65536/1024 = 64KB
     /*
     struct iovec {
         ptr_t iov_base; // iov_base指向的缓冲区存放的是readv所接收的数据或是writev将要发送的数据
@@ -21,31 +28,57 @@ ssize_t Buffer::readFd(int fd, int *saveErrno){
     };
     */
 
+    // 可读数据到了上限 等上层取走之后再读
+    const size_t room = maxSize_ - std::min(maxSize_, readableBytes());
+    if(room == 0){
+        *saveErrno = ENOBUFS;
+        return -1;
+    }
+    if(adaptiveRead_){
+        // 按最近的读取大小准备第一块iovec 常见情况下数据直接读进buffer_ 只有一次拷贝
+        const size_t hint = std::min(readSizeHint(), room);
+        if(writableBytes() < hint) ensureWritableBytes(hint);
+    }
+    // 读空后存储已经还给了BufferPool 先取一块初始大小的 小消息就可以直接读进来
+    else if(buffer_ == nullptr) ensureWritableBytes(initialSize_);
     // 使用iovec分配两个连续的缓冲区
     struct iovec vec[2];
-    const size_t writable = writableBytes();// 这是Buffer底层缓冲区剩余的可写空间大小 不一定能完全存储从fd读出的数据
+    const size_t writable = std::min(writableBytes(), room);// 这是Buffer底层缓冲区剩余的可写空间大小 不一定能完全存储从fd读出的数据
 
     //第一块缓冲区，指向可写空间
     vec[0].iov_base = begin() + writerIndex_;
     vec[0].iov_len = writable;
     //第二块缓冲区，指向栈空间
     vec[1].iov_base = extrabuf;
-    vec[1].iov_len = sizeof(extrabuf);
+    vec[1].iov_len = std::min(sizeof(t_extrabuf), room - writable);
     // when there is enough space in this buffer, don't read into extrabuf.
     // when extrabuf is used, we read 128k-1 bytes at most.
     // 这里之所以说最多128k-1字节，是因为若writable为64k-1，那么需要两个缓冲区 第一个64k-1 第二个64k 所以做多128k-1
     // 如果第一个缓冲区>=64k 那就只采用一个缓冲区 而不使用栈空间extrabuf[65536]的内容
-    const int iovcnt = (writable < sizeof(extrabuf)) ? 2 : 1;
+    const int iovcnt = (writable < sizeof(t_extrabuf) && vec[1].iov_len > 0) ? 2 : 1;
     const ssize_t n = ::readv(fd,vec,iovcnt); // ssize_t 有符号整数类型,readv:从文件描述符 fd 中读取数据，并分散（scatter）存储到多个连续的缓冲区中
     if(n<0){*saveErrno = errno;}
     else if(n<=writable) writerIndex_ += n; // 所有数据都存在了Buffer内部
     else{// 部分数据在Buffer内部，部分在extrabuf中
-        writerIndex_ = buffer_.size();
+        writerIndex_ += writable;
         append(extrabuf, n - writable);// 对buffer_扩容 并将extrabuf存储的另一部分数据追加至buffer_
     }
+    if(adaptiveRead_ && n>0) updateReadSize(static_cast<size_t>(n), writable);
     return n;
 }
 
+size_t Buffer::readSizeHint() const {
+    // 留出一半余量 让略大于平均值的消息也能一次读进来
+    size_t hint = readSizeEwma_ + readSizeEwma_ / 2;
+    return std::min(kMaxReadHint, std::max(kMinReadHint, hint));
+}
+
+void Buffer::updateReadSize(size_t n, size_t offered){
+    // 第一块iovec被读满 说明准备得不够 直接跟上本次的大小; 否则按1/8的权重慢慢收敛
+    if(n >= offered) readSizeEwma_ = std::max(readSizeEwma_, n);
+    else readSizeEwma_ = readSizeEwma_ - readSizeEwma_ / 8 + n / 8;
+}
+
 ssize_t Buffer::writeFd(int fd, int* saveErrno){
     ssize_t n = ::write(fd, peek(), readableBytes());
     if(n<0) *saveErrno = errno;
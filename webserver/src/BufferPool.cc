@@ -0,0 +1,85 @@
+#include <vector>
+#include <atomic>
+#include <new>
+
+#include "BufferPool.h"
+
+static const int kNumClasses = 9; // 1KB 2KB ... 256KB 各加kChunkHeadroom
+
+static std::atomic<size_t> g_maxRetainedBytes(4 * 1024 * 1024);
+
+// 线程退出时缓存已经析构 之后归还的块直接释放
+static thread_local bool t_cacheDestroyed = false;
+
+namespace{
+struct ThreadCache{
+    std::vector<char*> freeChunks[kNumClasses];
+    size_t retained = 0;
+
+    ~ThreadCache(){
+        for(auto& chunks : freeChunks){
+            for(char* chunk : chunks) ::operator delete(chunk);
+        }
+        t_cacheDestroyed = true;
+    }
+};
+thread_local ThreadCache t_cache;
+}
+
+// 超过最大级别的请求按原大小分配
+static const size_t kMaxClassCapacity = BufferPool::kMaxChunkSize + BufferPool::kChunkHeadroom;
+
+// 容量对应的级别 size <= kMaxClassCapacity
+static int classOf(size_t size){
+    if(size <= BufferPool::kMinChunkSize + BufferPool::kChunkHeadroom) return 0;
+    // 去掉头部空间后向上取整到2的幂 1KB是第0级
+    return 64 - __builtin_clzl(size - BufferPool::kChunkHeadroom - 1) - 10;
+}
+
+static size_t classCapacity(int index){
+    return (BufferPool::kMinChunkSize << index) + BufferPool::kChunkHeadroom;
+}
+
+size_t BufferPool::capacityFor(size_t size){
+    if(size == 0 || size > kMaxClassCapacity) return size;
+    return classCapacity(classOf(size));
+}
+
+char* BufferPool::allocate(size_t size, size_t* capacity){
+    if(size > kMaxClassCapacity){
+        *capacity = size;
+        return static_cast<char*>(::operator new(size));
+    }
+    const int index = classOf(size);
+    *capacity = classCapacity(index);
+    if(!t_cacheDestroyed){
+        std::vector<char*>& chunks = t_cache.freeChunks[index];
+        if(!chunks.empty()){
+            char* chunk = chunks.back();
+            chunks.pop_back();
+            t_cache.retained -= *capacity;
+            return chunk;
+        }
+    }
+    return static_cast<char*>(::operator new(*capacity));
+}
+
+void BufferPool::deallocate(char* chunk, size_t capacity){
+    if(chunk == nullptr) return;
+    // 非整级别的大块 或者缓存已满
+    if(capacity > kMaxClassCapacity || capacity != classCapacity(classOf(capacity)) || t_cacheDestroyed
+        || t_cache.retained + capacity > g_maxRetainedBytes.load(std::memory_order_relaxed)){
+        ::operator delete(chunk);
+        return;
+    }
+    t_cache.freeChunks[classOf(capacity)].push_back(chunk);
+    t_cache.retained += capacity;
+}
+
+void BufferPool::setMaxRetainedBytes(size_t bytes){
+    g_maxRetainedBytes.store(bytes, std::memory_order_relaxed);
+}
+
+size_t BufferPool::retainedBytes(){
+    return t_cacheDestroyed ? 0 : t_cache.retained;
+}
@@ -7,9 +7,10 @@
 const int Channel::kNoneEvent = 0; //空事件
 const int Channel::kReadEvent = EPOLLIN | EPOLLPRI;
 const int Channel::kWriteEvent = EPOLLOUT;
+const int Channel::kEdgeEvent = EPOLLET;
 
 // EventLoop: ChannelList Poller
-Channel::Channel(EventLoop* loop, int fd):loop_(loop),fd_(fd),events_(0),revents_(0),index_(-1),tied_(false){}
+Channel::Channel(EventLoop* loop, int fd):loop_(loop),fd_(fd),events_(0),revents_(0),index_(-1),edgeTriggered_(false),tied_(false){}
 
 Channel::~Channel(){}
 // channel的tie方法什么时候调用过?  TcpConnection => channel
@@ -37,6 +38,12 @@ void Channel::update(){
 // 在channel所属的EventLoop中把当前的channel删除掉
 void Channel::remove(){
     loop_->removeChannel(this);
+    // 借用者不会再收到通知 告诉它改用别的方式等待
+    if(readableHook_){
+        ReadableHook hook = std::move(readableHook_);
+        readableHook_ = nullptr;
+        hook(true);
+    }
 }
 
 void Channel::handleEvent(Timestamp receiveTime){
@@ -51,7 +58,16 @@ void Channel::handleEvent(Timestamp receiveTime){
 }
 
 void Channel::handleEventWithGuard(Timestamp receiveTime){
-    LOG_INFO<<"channel handleEvent revents:"<<revents_;
+    LOG_DEBUG<<"channel handleEvent revents:"<<revents_;
+    if(readableHook_ && (revents_ & (EPOLLIN | EPOLLPRI | EPOLLHUP | EPOLLERR))){
+        // 拷贝一份 hook里通常会取消自己
+        ReadableHook hook = readableHook_;
+        hook(false);
+        if((revents_ & EPOLLOUT) && (!edgeTriggered_ || isWriting())){
+            if(writeCallback_) writeCallback_();
+        }
+        return;
+    }
     // 关闭
     if((revents_ & EPOLLHUP) && !(revents_ & EPOLLIN)){
         if(closeCallback_) closeCallback_();
@@ -64,8 +80,8 @@ void Channel::handleEventWithGuard(Timestamp receiveTime){
     if(revents_ & (EPOLLIN | EPOLLPRI)){
         if(readCallback_) readCallback_(receiveTime);
     }
-    // 写
-    if(revents_ & EPOLLOUT){
+    // 写 边沿触发模式下EPOLLOUT常驻 只有确实在等待写时才回调
+    if((revents_ & EPOLLOUT) && (!edgeTriggered_ || isWriting())){
         if(writeCallback_) writeCallback_();
     }
 }
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include <algorithm>
+
+#include "ConnectionReaper.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+// 每个超时周期内扫描的次数 决定了关闭时机的精度
+static const double kSweepsPerTimeout = 8.0;
+static const double kMinSweepInterval = 0.01;
+static const double kMaxSweepInterval = 1.0;
+
+ConnectionReaper::ConnectionReaper(EventLoop* loop, double idleTimeout, double maxLifetime)
+    : loop_(loop)
+    , idleTimeout_(idleTimeout)
+    , maxLifetime_(maxLifetime)
+{
+    double shortest = kMaxSweepInterval * kSweepsPerTimeout;
+    if(idleTimeout_ > 0) shortest = std::min(shortest, idleTimeout_);
+    if(maxLifetime_ > 0) shortest = std::min(shortest, maxLifetime_);
+    double interval = std::max(kMinSweepInterval, shortest / kSweepsPerTimeout);
+    sweepTimer_ = loop_->runEvery(interval, std::bind(&ConnectionReaper::sweep, this));
+}
+
+ConnectionReaper::~ConnectionReaper(){
+    loop_->cancel(sweepTimer_);
+    for(TcpConnection* conn : activity_) conn->reaper_ = nullptr;
+}
+
+void ConnectionReaper::add(TcpConnection* conn){
+    Timestamp now = Timestamp::now();
+    conn->reaper_ = this;
+    conn->lastActivity_ = now;
+    conn->createTime_ = now;
+    conn->activityIt_ = activity_.insert(activity_.end(), conn);
+    conn->creationIt_ = creation_.insert(creation_.end(), conn);
+}
+
+void ConnectionReaper::touch(TcpConnection* conn, Timestamp now){
+    conn->lastActivity_ = now;
+    // 移到活跃链表尾部 只修改指针不分配内存
+    activity_.splice(activity_.end(), activity_, conn->activityIt_);
+}
+
+void ConnectionReaper::remove(TcpConnection* conn){
+    if(conn->reaper_ != this) return;
+    activity_.erase(conn->activityIt_);
+    creation_.erase(conn->creationIt_);
+    conn->reaper_ = nullptr;
+}
+
+void ConnectionReaper::sweep(){
+    Timestamp now = Timestamp::now();
+    int idle = 0;
+    int expired = 0;
+    while(idleTimeout_ > 0 && !activity_.empty()){
+        TcpConnection* conn = activity_.front();
+        if(now < addTime(conn->lastActivity_, idleTimeout_)) break;
+        remove(conn);
+        conn->forceClose();
+        ++idle;
+    }
+    while(maxLifetime_ > 0 && !creation_.empty()){
+        TcpConnection* conn = creation_.front();
+        if(now < addTime(conn->createTime_, maxLifetime_)) break;
+        remove(conn);
+        conn->forceClose();
+        ++expired;
+    }
+    if(idle > 0 || expired > 0) LOG_INFO<<"ConnectionReaper closed "<<idle<<" idle and "<<expired<<" expired connections";
+}
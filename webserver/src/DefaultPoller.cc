@@ -2,8 +2,11 @@
 
 #include <Poller.h>
 #include <EPollPoller.h>
+#include <IoUringPoller.h>
 
 Poller* Poller::newDefaultPoller(EventLoop* loop){
     if(::getenv("MUDUO_USE_POLL")) return nullptr;
+    // 设置MUDUO_USE_IOURING且内核支持时使用io_uring, 否则回退到epoll
+    else if(::getenv("MUDUO_USE_IOURING") && IoUringPoller::isSupported()) return new IoUringPoller(loop);
     else return new EPollPoller(loop); // 生成epoll的实例
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include <errno.h>
 #include<unistd.h>
 #include<string.h>
+#include<algorithm>
 
 #include<EPollPoller.h>
 #include "Logger.h"
@@ -20,8 +21,9 @@ EPollPoller::~EPollPoller(){
 }
 
 Timestamp EPollPoller::poll(int timeoutMs,ChannelList* activeChannels){
-    // 由于频繁调用poll 实际上应该用LOG_DEBUG输出日志更为合理 当遇到并发场景 关闭DEBUG日志提升效率
-    LOG_INFO<<"fd total count:"<<channels_.size();
+    // 每轮循环都会调用 只在DEBUG等级输出
+    LOG_DEBUG<<"fd total count:"<<numChannels_;
+    syncInterests();
     // int numEvents = ::epoll_wait(epollfd_,&*events_.begin(),static_cast<int>(events_.size()),timeoutMs);
     int numEvents = ::epoll_wait(epollfd_,events_.data(),static_cast<int>(events_.size()),timeoutMs);
     int saveErrno = errno;//errno 是一个全局变量，用于存储最近一次系统调用或库函数发生的错误代码,所以立刻保留
@@ -29,7 +31,7 @@ Timestamp EPollPoller::poll(int timeoutMs,ChannelList* activeChannels){
 
     // 存在事件
     if(numEvents>0){
-        LOG_INFO<<"events happend"<<numEvents; //LOG_DEBUG最合理
+        LOG_DEBUG<<"events happend"<<numEvents;
         fillActiveChannels(numEvents,activeChannels);
         // 满了的话就扩容
         if(numEvents == events_.size())
@@ -48,42 +50,62 @@ Timestamp EPollPoller::poll(int timeoutMs,ChannelList* activeChannels){
 }
 
 // channel update remove => EventLoop updateChannel removeChannel => Poller updateChannel removeChannel
+// 这里只登记 真正的epoll_ctl推迟到下一次epoll_wait之前
 void EPollPoller::updateChannel(Channel* channel){
     const int index = channel->index();
-    LOG_INFO<<"func =>"<<"fd"<<channel->fd()<<"events="<<channel->events()<<"index="<<index;
+    const int fd = channel->fd();
+    LOG_DEBUG<<"func =>"<<"fd"<<fd<<"events="<<channel->events()<<"index="<<index;
 
-    if (index == kNew || index == kDeleted){
-        if(index == kNew){
-            int fd = channel -> fd();
-            channels_[fd] = channel;
-        }else{// index == kDeleted
-
-        }
-        channel->set_index(kAdded);   // 2. 更新状态为“已添加”
-        update(EPOLL_CTL_ADD, channel); // 3. 发给epoll“添加”指令
-    }else{// channel已经在Poller中注册过了
-        int fd = channel->fd();
-        if(channel->isNoneEvent()){ // 1. 如果现在不关心任何事件了
-            update(EPOLL_CTL_DEL,channel);  // 就执行“删除”操作
-            channel->set_index(kDeleted);    // 状态置为“已删除”
-        }else update(EPOLL_CTL_MOD,channel); // 2. 否则，只是事件变化，执行“修改”操作
+    if(index == kNew){
+        addChannelEntry(channel);
+        if(static_cast<size_t>(fd) >= interests_.size()) interests_.resize(std::max(interests_.size() * 2, static_cast<size_t>(fd) + 1));
+    }
+    channel->set_index(kAdded);
+    Interest& interest = interests_[fd];
+    if(!interest.dirty){
+        interest.dirty = true;
+        dirtyFds_.push_back(fd);
     }
 }
 
 // 从Poller中删除channel
 void EPollPoller::removeChannel(Channel* channel){
     int fd = channel->fd();
-    channels_.erase(fd);
+    removeChannelEntry(fd);
 
-    LOG_INFO<<"removeChannel fd="<<fd;
+    LOG_DEBUG<<"removeChannel fd="<<fd;
 
-    int index = channel->index();
-    if (index == kAdded){
+    // 内核里还登记着就立即删除 dirtyFds_中残留的fd在同步时会被跳过
+    Interest& interest = interests_[fd];
+    if(interest.events != 0){
         update(EPOLL_CTL_DEL,channel);
+        interest.events = 0;
     }
     channel->set_index(kNew);
 }
 
+void EPollPoller::syncInterests(){
+    for(int fd : dirtyFds_){
+        Interest& interest = interests_[fd];
+        interest.dirty = false;
+        Channel* channel = channelOf(fd);
+        if(channel == nullptr) continue; // 同步之前已经removeChannel
+        const int events = channel->events();
+        if(events == interest.events) continue; // 与内核一致 不需要系统调用
+
+        if(events == 0){
+            update(EPOLL_CTL_DEL,channel);     // 不关心任何事件了 从内核删除
+            channel->set_index(kDeleted);
+        }else if(interest.events == 0){
+            update(EPOLL_CTL_ADD,channel);
+        }else{
+            update(EPOLL_CTL_MOD,channel);
+        }
+        interest.events = events;
+    }
+    dirtyFds_.clear();
+}
+
 // 填写活跃的链接
 void EPollPoller::fillActiveChannels(int numEvents, ChannelList* activeChannels) const{
     for(int i=0;i<numEvents; ++i){
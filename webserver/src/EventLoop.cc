@@ -2,17 +2,26 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <signal.h>
 #include <memory>
 
 #include <EventLoop.h>
 #include <Logger.h>
 #include <Channel.h>
 #include <Poller.h>
+#include <ZeroCopyHolder.h>
 // 防止一个线程中创建多个EventLoop实例
 thread_local EventLoop *t_loopInThisThread = nullptr; // 线程局部存储，确保每个线程有自己的EventLoop实例
 
 const int kPollTimeMs = 10000; // 10秒
 
+// 对端已经关闭时write/sendfile/splice会触发SIGPIPE 默认动作是终止整个进程 忽略后改为返回EPIPE
+class IgnoreSigPipe{
+public:
+  IgnoreSigPipe() { ::signal(SIGPIPE, SIG_IGN); }
+};
+IgnoreSigPipe initObj;
+
 /* 创建线程之后主线程和子线程谁先运行是不确定的。
 * 通过一个eventfd在线程之间传递数据的好处是多个线程无需上锁就可以实现同步。
 * eventfd支持的最低内核版本为Linux 2.6.27,在2.6.26及之前的版本也可以使用eventfd，但是flags必须设置为0。
@@ -37,7 +46,7 @@ int createEventfd()
   return evtfd;
 }
 
-EventLoop::EventLoop() : looping_(false), quit_(false), callingPendingFunctors_(false), threadId_(CurrentThread::tid()), poller_(Poller::newDefaultPoller(this)), wakeupFd_(createEventfd()), wakeupChannel_(new Channel(this, wakeupFd_))
+EventLoop::EventLoop() : looping_(false), quit_(false), connectionCount_(0), busyPermille_(0), callingPendingFunctors_(false), wakeupPending_(false), threadId_(CurrentThread::tid()), poller_(Poller::newDefaultPoller(this)), timerQueue_(new TimerQueue(this)), wakeupFd_(createEventfd()), wakeupChannel_(new Channel(this, wakeupFd_))
 {
   LOG_DEBUG << "EventLoop created" << this << "in thread" << threadId_;
 
@@ -51,18 +60,26 @@ EventLoop::EventLoop() : looping_(false), quit_(false), callingPendingFunctors_(
 }
 EventLoop::~EventLoop()
 {
+  zeroCopyHolder_.reset(); // 要在timerQueue_之前析构 它会取消自己的定时器
   wakeupChannel_->disableAll(); // 给Channel移除所有感兴趣的事件
   wakeupChannel_->remove();     // 把Channel从EventLoop上删除掉
   ::close(wakeupFd_);
   t_loopInThisThread = nullptr;
 }
 
+ZeroCopyHolder* EventLoop::zeroCopyHolder(){
+  if (!zeroCopyHolder_)
+    zeroCopyHolder_.reset(new ZeroCopyHolder(this));
+  return zeroCopyHolder_.get();
+}
+
 // 开启事件循环
 void EventLoop::loop(){
   looping_ = true;
   quit_ = false;
 
   LOG_INFO<<"EventLoop start looping";
+  Timestamp iterationEnd(Timestamp::now());
   while(!quit_){
     activeChannels_.clear();
     pollReturnTime_ = poller_->poll(kPollTimeMs,&activeChannels_);
@@ -77,6 +94,15 @@ void EventLoop::loop(){
      * mainloop调用queueInLoop将回调加入subloop（该回调需要subloop执行 但subloop还在poller_->poll处阻塞） queueInLoop通过wakeup将subloop唤醒
      **/
     doPendingFunctors();
+    // 统计本轮忙碌时间占比: 忙碌 = poll返回到本轮结束 空闲 = 上轮结束到poll返回
+    Timestamp now(Timestamp::now());
+    int64_t busy = now.microSecondsSinceEpoch() - pollReturnTime_.microSecondsSinceEpoch();
+    int64_t total = now.microSecondsSinceEpoch() - iterationEnd.microSecondsSinceEpoch();
+    if(total > 0){
+      int sample = static_cast<int>(busy * 1000 / total);
+      busyPermille_ = busyPermille_ + (sample - busyPermille_) / 8; // 1/8权重的指数滑动平均
+    }
+    iterationEnd = now;
   }
   LOG_INFO<<"EventLoopstop looping";
   looping_ = false;
@@ -108,17 +134,16 @@ void EventLoop::runInLoop(Functor cb){
 
 // 把cb放入队列中 唤醒loop所在的线程执行cb
 void EventLoop::queueInLoop(Functor cb){
-  // 创建了一个作用域锁
-  {
-    std::unique_lock<std::mutex> lock(mutex_);
-    pendingFunctors_.emplace_back(cb);
-  }
+  // 无锁入队 多个线程可以同时投递
+  pendingFunctors_.push(std::move(cb));
   /**
    * || callingPendingFunctors的意思是 当前loop正在执行回调中 但是loop的pendingFunctors_中又加入了新的回调 需要通过wakeup写事件
    * 唤醒相应的需要执行上面回调操作的loop的线程 让loop()下一次poller_->poll()不再阻塞（阻塞的话会延迟前一次新加入的回调的执行），然后
    * 继续执行pendingFunctors_中的回调函数
+   *
+   * wakeupPending_合并唤醒: loop处理回调之前 N个生产者只需要第一个写一次eventfd
    **/
-  if(!isInLoopThread() || callingPendingFunctors_) wakeup();
+  if((!isInLoopThread() || callingPendingFunctors_) && !wakeupPending_.exchange(true)) wakeup();
 }
 
 void EventLoop::handleRead(){
@@ -153,13 +178,19 @@ bool EventLoop::hasChannel(Channel *channel)
   return poller_->hasChannel(channel);
 }
 
+Channel* EventLoop::channelOf(int fd)
+{
+  return poller_->channelOf(fd);
+}
+
 void EventLoop::doPendingFunctors(){
   std::vector<Functor> functors;
   callingPendingFunctors_ = true;
-  {
-    std::unique_lock<std::mutex> lock(mutex_);
-    functors.swap(pendingFunctors_);// 交换的方式减少了锁的临界区范围 提升效率 同时避免了死锁 如果执行functor()在临界区内 且functor()中调用queueInLoop()就会产生死锁
-  }
+  // 先清除唤醒标记再取回调 之后入队的生产者会重新唤醒loop 不会丢失唤醒
+  wakeupPending_ = false;
+  // 只取出当前已经入队的回调 执行期间新加入的回调留到下一轮 避免回调不断投递自身导致loop饿死
+  Functor cb;
+  while(pendingFunctors_.pop(cb)) functors.push_back(std::move(cb));
 
   for(const Functor &functor:functors){
     functor();// 执行当前loop需要执行的回调操作
@@ -1,13 +1,14 @@
 #include "EventLoopThread.h"
 #include "EventLoop.h"
 
-EventLoopThread::EventLoopThread(const ThreadInitCallback& cb, const std::string& name)
+EventLoopThread::EventLoopThread(const ThreadInitCallback& cb, const std::string& name, const ThreadPlacement& placement)
     : loop_(nullptr)
     , exiting_(false)
     , thread_(std::bind(&EventLoopThread::threadFunc,this),name)
     , mutex_()
     , cond_()
-    , callback_(cb){}
+    , callback_(cb)
+    , placement_(placement){}
 
 EventLoopThread::~EventLoopThread(){
     exiting_ = true;
@@ -29,6 +30,8 @@ EventLoop* EventLoopThread::startLoop(){
 }
 // 下面这个方法 是在单独的新线程里运行的
 void EventLoopThread::threadFunc(){
+    // 先绑核并设置内存策略 再创建EventLoop 让loop自身的分配也落在本地节点
+    ThreadAffinity::apply(placement_);
     EventLoop loop;// 每个线程有自己独立的EventLoop实例
 
     if(callback_) callback_(&loop);
@@ -1,10 +1,23 @@
 #include <memory>
+#include <arpa/inet.h>
 
 #include "EventLoopThreadPool.h"
 #include "EventLoopThread.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
 #include "Logger.h"
 
-EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseLoop,const std::string& nameArg) : baseLoop_(baseLoop),name_(nameArg),started_(false),numThreads_(0),next_(0){}
+// murmur3的fmix32 输入的每一位都会影响输出的所有位
+static uint32_t mixBits(uint32_t h){
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseLoop,const std::string& nameArg) : baseLoop_(baseLoop),name_(nameArg),started_(false),numThreads_(0),next_(0),policy_(kRoundRobin),rng_(std::random_device()()){}
 
 EventLoopThreadPool::~EventLoopThreadPool(){
     // Don't delete loop, it's stack variable
@@ -15,7 +28,10 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb){
     for(int i=0;i<numThreads_;++i){
         char buf[name_.size() + 32];
         snprintf(buf, sizeof buf,"%s%d",name_.c_str(),i);
-        EventLoopThread* t = new EventLoopThread(cb,buf);
+        ThreadPlacement placement;
+        if(!cpus_.empty()) placement.cpus.push_back(cpus_[i % cpus_.size()]);
+        if(!numaNodes_.empty()) placement.numaNode = numaNodes_[i % numaNodes_.size()];
+        EventLoopThread* t = new EventLoopThread(cb,buf,placement);
         threads_.push_back(std::unique_ptr<EventLoopThread>(t));
         loops_.push_back(t->startLoop()); // 底层创建线程 绑定一个新的EventLoop 并返回该loop的地址
     }
@@ -23,17 +39,60 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb){
 }
 
 EventLoop* EventLoopThreadPool::getNextLoop(){
+    return selectLoop(nullptr);
+}
+
+EventLoop* EventLoopThreadPool::getNextLoop(const InetAddress& peerAddr){
+    return selectLoop(&peerAddr);
+}
+
+EventLoop* EventLoopThreadPool::selectLoop(const InetAddress* peerAddr){
     // 如果只设置一个线程 也就是只有一个mainReactor 无subReactor 
     // 那么轮询只有一个线程 getNextLoop()每次都返回当前的baseLoop_
-    EventLoop* loop = baseLoop_;
-    // 通过轮询获取下一个处理事件的loop
-    // 如果没设置多线程数量，则不会进去，相当于直接返回baseLoop
-    if(!loops_.empty()){
-        loop = loops_[next_];
-        ++next_;
-        //轮询
-        if(next_ >= loops_.size()) next_ = 0;
+    // 如果没设置多线程数量，相当于直接返回baseLoop
+    if(loops_.empty()) return baseLoop_;
+    const size_t n = loops_.size();
+    switch(policy_){
+    case kLeastConnections:{
+        // 从轮询位置开始扫描 连接数相同时依次分散到不同loop
+        size_t start = next_;
+        next_ = (next_ + 1) % n;
+        EventLoop* best = loops_[start];
+        for(size_t i=1;i<n;++i){
+            EventLoop* loop = loops_[(start + i) % n];
+            if(loop->connectionCount() < best->connectionCount()) best = loop;
+        }
+        return best;
+    }
+    case kPowerOfTwoChoices:
+    case kPowerOfTwoBusy:{
+        if(n == 1) return loops_[0];
+        size_t a = rng_() % n;
+        size_t b = rng_() % (n - 1);
+        if(b >= a) ++b; // 保证两次选中的loop不同
+        EventLoop* x = loops_[a];
+        EventLoop* y = loops_[b];
+        if(policy_ == kPowerOfTwoChoices) return y->connectionCount() < x->connectionCount() ? y : x;
+        return y->busyPermille() < x->busyPermille() ? y : x;
+    }
+    case kHashByPeer:
+        if(peerAddr){
+            // 地址是网络字节序 std::hash<uint32_t>又是恒等映射, 直接取模只看第一个字节 同一网段的客户端都落到同一个loop
+            // 先转成主机字节序再打散所有位 乘法映射到[0, n)
+            const uint32_t ip = ntohl(peerAddr->getSockAddr()->sin_addr.s_addr);
+            return loops_[static_cast<uint64_t>(mixBits(ip)) * n >> 32];
+        }
+        return roundRobin();
+    default:
+        return roundRobin();
     }
+}
+
+EventLoop* EventLoopThreadPool::roundRobin(){
+    EventLoop* loop = loops_[next_];
+    ++next_;
+    //轮询
+    if(next_ >= loops_.size()) next_ = 0;
     return loop;
 }
 
@@ -0,0 +1,275 @@
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <algorithm>
+
+#include "IoUringPoller.h"
+#include "Logger.h"
+#include "Channel.h"
+
+// 与EPollPoller保持一致的channel状态
+const int kNew = -1;
+const int kAdded = 1;
+const int kDeleted = 2;
+
+// POLL_REMOVE等不关心结果的请求使用该user_data 合法请求的gen从1开始 所以不会冲突
+static const uint64_t kIgnoreUserData = 0;
+
+static inline uint64_t encodeUserData(int fd, unsigned gen){
+    return (static_cast<uint64_t>(gen) << 32) | static_cast<uint32_t>(fd);
+}
+
+static inline unsigned loadAcquire(const unsigned* p){
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline void storeRelease(unsigned* p, unsigned v){
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+IoUringPoller::IoUringPoller(EventLoop* loop)
+    : Poller(loop)
+    , ringfd_(-1)
+    , sqRing_(nullptr)
+    , sqRingSize_(0)
+    , cqRing_(nullptr)
+    , cqRingSize_(0)
+    , sqes_(nullptr)
+    , sqesSize_(0)
+    , pending_(0)
+    , round_(0)
+    , states_(64)
+{
+    setupRing();
+}
+
+IoUringPoller::~IoUringPoller(){
+    if(sqes_) ::munmap(sqes_, sqesSize_);
+    if(cqRing_ && cqRing_ != sqRing_) ::munmap(cqRing_, cqRingSize_);
+    if(sqRing_) ::munmap(sqRing_, sqRingSize_);
+    if(ringfd_ >= 0) ::close(ringfd_);
+}
+
+bool IoUringPoller::isSupported(){
+    static const bool supported = [](){
+        io_uring_params params;
+        ::memset(&params, 0, sizeof(params));
+        int fd = static_cast<int>(::syscall(__NR_io_uring_setup, 2, &params));
+        if(fd < 0) return false;
+        ::close(fd);
+        const unsigned required = IORING_FEAT_EXT_ARG | IORING_FEAT_NODROP;
+        return (params.features & required) == required;
+    }();
+    return supported;
+}
+
+void IoUringPoller::setupRing(){
+    io_uring_params params;
+    ::memset(&params, 0, sizeof(params));
+    ringfd_ = static_cast<int>(::syscall(__NR_io_uring_setup, kRingEntries, &params));
+    if(ringfd_ < 0) LOG_FATAL<<"io_uring_setup error:"<<errno;
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    // 新内核中SQ和CQ共用一次mmap
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if(singleMmap) sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+
+    sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd_, IORING_OFF_SQ_RING);
+    if(sqRing_ == MAP_FAILED) LOG_FATAL<<"io_uring mmap sq ring error:"<<errno;
+    if(singleMmap) cqRing_ = sqRing_;
+    else{
+        cqRing_ = ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd_, IORING_OFF_CQ_RING);
+        if(cqRing_ == MAP_FAILED) LOG_FATAL<<"io_uring mmap cq ring error:"<<errno;
+    }
+    sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd_, IORING_OFF_SQES);
+    if(sqes == MAP_FAILED) LOG_FATAL<<"io_uring mmap sqes error:"<<errno;
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sqEntries_ = params.sq_entries;
+
+    char* cq = static_cast<char*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+}
+
+Timestamp IoUringPoller::poll(int timeoutMs, ChannelList* activeChannels){
+    LOG_DEBUG<<"fd total count:"<<numChannels_;
+    // 上一轮触发过的一次性poll在这里重新布防 与本轮等待合并成同一次io_uring_enter
+    for(int fd : rearmFds_){
+        PollState& state = states_[fd];
+        if(state.rearm && state.channel && !state.armed && !state.channel->isNoneEvent()) arm(fd, state);
+        state.rearm = false;
+    }
+    rearmFds_.clear();
+    ++round_;
+
+    int ret = enter(pending_, 1, IORING_ENTER_GETEVENTS, timeoutMs);
+    int saveErrno = errno;
+    Timestamp now(Timestamp::now());
+
+    if(ret < 0 && saveErrno != ETIME && saveErrno != EINTR){
+        errno = saveErrno;
+        LOG_ERROR<<"IoUringPoller::poll() error!";
+    }
+    fillActiveChannels(activeChannels);
+    if(activeChannels->empty()) LOG_DEBUG<<"timeout!";
+    else LOG_DEBUG<<"events happend"<<activeChannels->size();
+    return now;
+}
+
+void IoUringPoller::updateChannel(Channel* channel){
+    const int index = channel->index();
+    const int fd = channel->fd();
+    LOG_DEBUG<<"func =>"<<"fd"<<fd<<"events="<<channel->events()<<"index="<<index;
+
+    PollState& state = stateOf(fd);
+    if(index == kNew || index == kDeleted){
+        if(index == kNew) addChannelEntry(channel);
+        state.channel = channel;
+        channel->set_index(kAdded);
+        arm(fd, state);
+    }else{
+        // 挂着的poll请求关心的事件没有变化 不需要撤销重布
+        if(state.armed && state.events == static_cast<uint32_t>(channel->events())) return;
+        // 事件变化: 撤销旧的poll请求 再按新的事件重新布防
+        disarm(fd, state);
+        if(channel->isNoneEvent()) channel->set_index(kDeleted);
+        else arm(fd, state);
+    }
+}
+
+void IoUringPoller::removeChannel(Channel* channel){
+    const int fd = channel->fd();
+    removeChannelEntry(fd);
+    LOG_DEBUG<<"removeChannel fd="<<fd;
+
+    PollState& state = stateOf(fd);
+    bool armed = state.armed;
+    disarm(fd, state);
+    state.channel = nullptr;
+    channel->set_index(kNew);
+    // 挂在内核中的poll会持有file引用 fd随后就会被close 立即提交让连接及时真正关闭
+    if(armed) enter(pending_, 0, 0, -1);
+}
+
+void IoUringPoller::arm(int fd, PollState& state){
+    if(++state.gen == 0) ++state.gen;
+    const uint32_t events = static_cast<uint32_t>(state.channel->events());
+    state.events = events;
+
+    io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events & ~static_cast<uint32_t>(EPOLLET);
+    // 边沿触发使用multishot 水平触发使用一次性poll 触发后由poll()重新布防
+    if(events & EPOLLET) sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = encodeUserData(fd, state.gen);
+    state.armed = true;
+}
+
+void IoUringPoller::disarm(int fd, PollState& state){
+    if(state.armed){
+        io_uring_sqe* sqe = getSqe();
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = encodeUserData(fd, state.gen);
+        sqe->user_data = kIgnoreUserData;
+        state.armed = false;
+    }
+    // 递增gen 使已经产生但还未处理的旧CQE失效
+    if(++state.gen == 0) ++state.gen;
+}
+
+io_uring_sqe* IoUringPoller::getSqe(){
+    unsigned tail = *sqTail_;
+    // SQ满了 先把已有的请求提交给内核
+    if(tail - loadAcquire(sqHead_) >= sqEntries_) enter(pending_, 0, 0, -1);
+
+    unsigned index = tail & *sqMask_;
+    io_uring_sqe* sqe = &sqes_[index];
+    ::memset(sqe, 0, sizeof(*sqe));
+    sqArray_[index] = index;
+    storeRelease(sqTail_, tail + 1);
+    ++pending_;
+    return sqe;
+}
+
+int IoUringPoller::enter(unsigned toSubmit, unsigned minComplete, unsigned flags, int timeoutMs){
+    io_uring_getevents_arg arg;
+    __kernel_timespec ts;
+    void* argp = nullptr;
+    size_t argsz = 0;
+    if((flags & IORING_ENTER_GETEVENTS) && timeoutMs >= 0){
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000 * 1000;
+        ::memset(&arg, 0, sizeof(arg));
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+        argp = &arg;
+        argsz = sizeof(arg);
+        flags |= IORING_ENTER_EXT_ARG;
+    }
+    int ret = static_cast<int>(::syscall(__NR_io_uring_enter, ringfd_, toSubmit, minComplete, flags, argp, argsz));
+    // 内核已经消费掉的sqe不再计入pending_
+    pending_ = *sqTail_ - loadAcquire(sqHead_);
+    if(ret < 0 && errno != ETIME && errno != EINTR) LOG_ERROR<<"io_uring_enter error:"<<errno;
+    return ret;
+}
+
+void IoUringPoller::fillActiveChannels(ChannelList* activeChannels){
+    unsigned head = *cqHead_;
+    const unsigned tail = loadAcquire(cqTail_);
+    for(; head != tail; ++head){
+        const io_uring_cqe* cqe = &cqes_[head & *cqMask_];
+        if(cqe->user_data == kIgnoreUserData) continue;
+
+        const int fd = static_cast<int>(cqe->user_data & 0xffffffff);
+        const unsigned gen = static_cast<unsigned>(cqe->user_data >> 32);
+        if(fd < 0 || static_cast<size_t>(fd) >= states_.size()) continue;
+        PollState& state = states_[fd];
+        // channel已删除或事件已修改 这是旧请求的CQE
+        if(state.channel == nullptr || state.gen != gen) continue;
+
+        if(cqe->res < 0){
+            state.armed = false;
+            if(cqe->res != -ECANCELED) LOG_ERROR<<"IoUringPoller poll fd="<<fd<<" error:"<<-cqe->res;
+            continue;
+        }
+        // 没有F_MORE说明该poll请求已结束(一次性poll或multishot被内核终止) 需要重新布防
+        if(!(cqe->flags & IORING_CQE_F_MORE)){
+            state.armed = false;
+            if(!state.rearm){
+                state.rearm = true;
+                rearmFds_.push_back(fd);
+            }
+        }
+        // multishot下同一轮可能收到同一fd的多个CQE 合并为一次上报
+        if(state.round != round_){
+            state.round = round_;
+            state.revents = 0;
+            activeChannels->push_back(state.channel);
+        }
+        state.revents |= cqe->res;
+    }
+    storeRelease(cqHead_, head);
+
+    for(Channel* channel : *activeChannels){
+        channel->set_revents(states_[channel->fd()].revents);
+    }
+}
+
+IoUringPoller::PollState& IoUringPoller::stateOf(int fd){
+    if(static_cast<size_t>(fd) >= states_.size()) states_.resize(std::max(states_.size() * 2, static_cast<size_t>(fd) + 1));
+    return states_[fd];
+}
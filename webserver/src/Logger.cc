@@ -1,3 +1,7 @@
+#include <stdlib.h>
+#include <mutex>
+#include <unordered_map>
+
 #include "Logger.h"
 #include "CurrentThread.h"
 
@@ -45,13 +49,48 @@ static void defaultFlush(){
 Logger::OutputFunc g_output = defaultOutput;
 Logger::FlushFunc g_flush = defaultFlush;
 
+static Logger::LogLevel initLogLevel(){
+    if(::getenv("MUDUO_LOG_TRACE")) return Logger::TRACE;
+    else if(::getenv("MUDUO_LOG_DEBUG")) return Logger::DEBUG;
+    else return Logger::INFO;
+}
+
+// 日志等级配置 只在设置和LogSite重新计算时访问 不在热路径上
+namespace LogConfig
+{
+    std::mutex mutex;
+    Logger::LogLevel globalLevel = initLogLevel();
+    std::unordered_map<std::string, Logger::LogLevel> moduleLevels;
+}
+
+std::atomic<unsigned> LogSite::s_generation_(1);
+
+// 按__FILE__取出模块名(文件名去掉目录和扩展名) 再查该模块的覆盖等级
+void LogSite::resolve(unsigned gen){
+    const char* slash = strrchr(file_, '/');
+    const char* base = slash ? slash + 1 : file_;
+    const char* dot = strrchr(base, '.');
+    std::string module(base, dot ? dot - base : strlen(base));
+
+    int threshold;
+    {
+        std::lock_guard<std::mutex> lock(LogConfig::mutex);
+        auto it = LogConfig::moduleLevels.find(module);
+        threshold = it != LogConfig::moduleLevels.end() ? it->second : LogConfig::globalLevel;
+    }
+    // 先写等级再写代数 期间配置若又变化 全局代数已经不同 下次会重新计算
+    threshold_.store(threshold, std::memory_order_relaxed);
+    generation_.store(gen, std::memory_order_release);
+}
+
 // 实现Impl构造函数
 Logger::Impl::Impl(Logger::LogLevel level,int savedErrno,const char* filename,int line)
     : time_(Timestamp::now()), // 显式初始化 time_
       stream_(),              // 显式调用 LogStream 的默认构造函数,与其他成员变量的初始化风格保持一致（所有成员都在初始化列表中显式处理）
       level_(level),          // 初始化 level_
       line_(line),            // 初始化 line_
-      basename_(filename)     // 初始化 basename_
+      basename_(filename),    // 初始化 basename_
+      suppressed_(0)
     {
     // 显示调用格式化时间
     formatTime();
@@ -63,37 +102,50 @@ Logger::Impl::Impl(Logger::LogLevel level,int savedErrno,const char* filename,in
     }
 }
 // formatTime实现：根据时区格式化当前时间字符串, 也是一条log消息的开头
+// 年月日时分秒部分按线程缓存 同一秒内只需要拼上微秒
 void Logger::Impl::formatTime(){
-    Timestamp now = Timestamp::now();
     // 计算秒数
-    time_t seconds = static_cast<time_t>(now.microSecondsSinceEpoch() / Timestamp::kMicroSecondsPerSecond);
-    int microseconds = static_cast<int>(now.microSecondsSinceEpoch() % Timestamp::kMicroSecondsPerSecond);
+    time_t seconds = time_.secondsSinceEpoch();
     // 计算剩余微秒数
-    struct tm* tm_timer = localtime(&seconds);
-    // 写入当前线程存储时间的buf中
-    snprintf(ThreadInfo::t_timer,sizeof(ThreadInfo::t_timer),"%4d/%02d/%02d %02d:%02d:%02d",
-        tm_timer->tm_year + 1900,
-        tm_timer->tm_mon + 1,
-        tm_timer->tm_mday,
-        tm_timer->tm_hour,
-        tm_timer->tm_min,
-        tm_timer->tm_sec
-    );
-    // 更新最后一次时间调用
-    ThreadInfo::t_lastSecond = seconds;
-    // muduo使用Fmt格式化整数，这里我们直接写入buf
-    char buf[32] = {0};
-    snprintf(buf, sizeof(buf), "%06d ", microseconds);
-
-    stream_ << GeneralTemplate(ThreadInfo::t_timer, 17) << GeneralTemplate(buf,7);
+    int microseconds = static_cast<int>(time_.microSecondsSinceEpoch() % Timestamp::kMicroSecondsPerSecond);
+    if(seconds != ThreadInfo::t_lastSecond){
+        struct tm tm_time;
+        localtime_r(&seconds, &tm_time);
+        // 写入当前线程存储时间的buf中
+        snprintf(ThreadInfo::t_timer,sizeof(ThreadInfo::t_timer),"%4d/%02d/%02d %02d:%02d:%02d",
+            tm_time.tm_year + 1900,
+            tm_time.tm_mon + 1,
+            tm_time.tm_mday,
+            tm_time.tm_hour,
+            tm_time.tm_min,
+            tm_time.tm_sec
+        );
+        // 更新最后一次时间调用
+        ThreadInfo::t_lastSecond = seconds;
+    }
+    // ".uuuuuu "
+    char buf[8];
+    buf[0] = '.';
+    for(int i = 6; i >= 1; --i){
+        buf[i] = static_cast<char>('0' + microseconds % 10);
+        microseconds /= 10;
+    }
+    buf[7] = ' ';
+
+    stream_ << GeneralTemplate(ThreadInfo::t_timer, 19) << GeneralTemplate(buf, 8);
 }
 void Logger::Impl::finish(){
+    if(suppressed_ > 0) stream_ << " (" << suppressed_ << " suppressed)";
     stream_ << " - " << GeneralTemplate(basename_.data_, basename_.size_) << ':' << line_ << '\n';
 }
 
 Logger::Logger(const char *filename, int line, LogLevel level) : impl_(level, 0, filename, line)
 {
 }
+Logger::Logger(const char *filename, int line, LogLevel level, uint64_t suppressed) : impl_(level, 0, filename, line)
+{
+    impl_.suppressed_ = suppressed;
+}
 Logger::~Logger(){
     impl_.finish(); // 在析构时调用finish写入
     const LogStream::Buffer &buffer = stream().buffer();
@@ -112,4 +164,37 @@ void Logger::setOutput(OutputFunc out){
 
 void Logger::setFlush(FlushFunc flush){
     g_flush = flush;
+}
+
+void Logger::output(const char* data, int len){
+    g_output(data, len);
+}
+
+Logger::LogLevel Logger::logLevel(){
+    std::lock_guard<std::mutex> lock(LogConfig::mutex);
+    return LogConfig::globalLevel;
+}
+
+void Logger::setLogLevel(LogLevel level){
+    {
+        std::lock_guard<std::mutex> lock(LogConfig::mutex);
+        LogConfig::globalLevel = level;
+    }
+    LogSite::invalidate();
+}
+
+void Logger::setModuleLevel(const std::string& module, LogLevel level){
+    {
+        std::lock_guard<std::mutex> lock(LogConfig::mutex);
+        LogConfig::moduleLevels[module] = level;
+    }
+    LogSite::invalidate();
+}
+
+void Logger::clearModuleLevel(const std::string& module){
+    {
+        std::lock_guard<std::mutex> lock(LogConfig::mutex);
+        LogConfig::moduleLevels.erase(module);
+    }
+    LogSite::invalidate();
 }
\ No newline at end of file
@@ -0,0 +1,288 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <string.h>
+#include <algorithm>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+
+#include "OutputQueue.h"
+#include "Logger.h"
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+const size_t OutputQueue::kMaxFileChunk;
+const size_t OutputQueue::kMaxSpliceChunk;
+
+OutputQueue::~OutputQueue(){
+    closePipe();
+}
+
+void OutputQueue::append(const char* data, size_t len){
+    if(len == 0) return;
+    if(segments_.empty() || segments_.back().kind != kBytes || segments_.back().bytes.readableBytes() + len > kMaxCopySegment){
+        segments_.emplace_back();
+    }
+    segments_.back().bytes.append(data, len);
+    bytes_ += len;
+}
+
+void OutputQueue::append(const Slice& slice){
+    if(slice.size() < kCopyThreshold){
+        append(slice.data(), slice.size());
+        return;
+    }
+    segments_.emplace_back();
+    segments_.back().kind = kSlice;
+    segments_.back().slice = slice;
+    bytes_ += slice.size();
+}
+
+void OutputQueue::appendFile(int fd, off_t offset, size_t count, const FileCompleteCallback& cb){
+    segments_.emplace_back();
+    Segment& seg = segments_.back();
+    seg.kind = kFile;
+    seg.fd = fd;
+    seg.offset = offset;
+    seg.remaining = count;
+    seg.done = cb;
+    bytes_ += count;
+}
+
+void OutputQueue::appendSplice(int srcFd, size_t count, const FileCompleteCallback& cb){
+    segments_.emplace_back();
+    Segment& seg = segments_.back();
+    seg.kind = kSplice;
+    seg.fd = srcFd;
+    seg.remaining = count;
+    seg.done = cb;
+    bytes_ += count;
+}
+
+ssize_t OutputQueue::writeFd(int fd, int* saveErrno){
+    blockedSource_ = -1;
+    if(segments_.empty()) return 0;
+    switch(segments_.front().kind){
+        case kFile: return writeFile(fd, saveErrno);
+        case kSplice: return writeSplice(fd, saveErrno);
+        default: return writeMemory(fd, saveErrno);
+    }
+}
+
+bool OutputQueue::useZeroCopy(const Segment& seg) const {
+    return zeroCopyThreshold_ > 0 && seg.kind == kSlice && seg.size() >= zeroCopyThreshold_;
+}
+
+ssize_t OutputQueue::writeMemory(int fd, int* saveErrno){
+    if(useZeroCopy(segments_.front())) return writeZeroCopy(fd, saveErrno);
+    struct iovec vec[IOV_MAX];
+    int iovcnt = 0;
+    // 只收集队首连续的内存数据段 遇到文件区间或者要走零拷贝的Slice就停下 保证发送顺序
+    for(auto it = segments_.begin(); it != segments_.end() && it->inMemory() && iovcnt < IOV_MAX; ++it){
+        if(iovcnt > 0 && useZeroCopy(*it)) break;
+        if(it->size() == 0) continue;
+        vec[iovcnt].iov_base = const_cast<char*>(it->data());
+        vec[iovcnt].iov_len = it->size();
+        ++iovcnt;
+    }
+    if(iovcnt == 0) return 0;
+    ssize_t n = ::writev(fd, vec, iovcnt);
+    if(n < 0) *saveErrno = errno;
+    else consume(static_cast<size_t>(n));
+    return n;
+}
+
+ssize_t OutputQueue::writeZeroCopy(int fd, int* saveErrno){
+    Segment& front = segments_.front();
+    struct iovec vec;
+    vec.iov_base = const_cast<char*>(front.data());
+    vec.iov_len = front.size();
+    struct msghdr msg;
+    ::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &vec;
+    msg.msg_iovlen = 1;
+    ssize_t n = ::sendmsg(fd, &msg, MSG_ZEROCOPY);
+    if(n < 0 && errno == ENOBUFS){
+        // 锁定的内存超过了optmem限制 这一次退回普通发送
+        n = ::writev(fd, &vec, 1);
+        if(n < 0) *saveErrno = errno;
+        else consume(static_cast<size_t>(n));
+        return n;
+    }
+    if(n < 0){
+        *saveErrno = errno;
+        return -1;
+    }
+    // 已发送的部分在收到完成通知之前不能释放
+    zeroCopyPinned_.emplace_back(zeroCopyNextSeq_++, front.slice.subslice(0, n));
+    consume(static_cast<size_t>(n));
+    return n;
+}
+
+int OutputQueue::reapZeroCopy(int fd, PinnedList& pinned, uint64_t* copied){
+    int reaped = 0;
+    for(;;){
+        char control[128];
+        struct msghdr msg;
+        ::memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if(::recvmsg(fd, &msg, MSG_ERRQUEUE) < 0) break; // EAGAIN: 错误队列已经读空
+        for(struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)){
+            if(!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                 (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) continue;
+            const struct sock_extended_err* serr = reinterpret_cast<const struct sock_extended_err*>(CMSG_DATA(cm));
+            if(serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+            // [ee_info, ee_data]这一段序号的发送都已完成 序号是32位回绕的
+            const uint32_t hi = serr->ee_data;
+            while(!pinned.empty() && static_cast<int32_t>(hi - pinned.front().first) >= 0){
+                pinned.pop_front();
+            }
+            if(serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) ++*copied;
+            ++reaped;
+        }
+    }
+    return reaped;
+}
+
+size_t OutputQueue::zeroCopyPinnedBytes() const {
+    size_t bytes = 0;
+    for(const auto& pinned : zeroCopyPinned_) bytes += pinned.second.size();
+    return bytes;
+}
+
+ssize_t OutputQueue::writeFile(int fd, int* saveErrno){
+    Segment& front = segments_.front();
+    if(front.remaining == 0){
+        finishFront(true);
+        return 0;
+    }
+    ssize_t n = ::sendfile(fd, front.fd, &front.offset, std::min(front.remaining, kMaxFileChunk));
+    if(n > 0){
+        front.remaining -= n;
+        bytes_ -= n;
+        if(front.remaining == 0) finishFront(true);
+        return n;
+    }
+    if(n == 0){
+        // 文件比请求的区间短
+        LOG_ERROR<<"OutputQueue::writeFile unexpected EOF on fd="<<front.fd;
+        finishFront(false);
+        return 0;
+    }
+    if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EPIPE || errno == ECONNRESET){
+        *saveErrno = errno;
+        return -1;
+    }
+    // 其他错误归咎于源文件 放弃这个文件继续发送后面的数据
+    LOG_ERROR<<"OutputQueue::writeFile sendfile fd="<<front.fd<<" error:"<<errno;
+    finishFront(false);
+    return 0;
+}
+
+ssize_t OutputQueue::writeSplice(int fd, int* saveErrno){
+    Segment& front = segments_.front();
+    if(pipe_[0] < 0 && ::pipe2(pipe_, O_NONBLOCK | O_CLOEXEC) < 0){
+        LOG_ERROR<<"OutputQueue::writeSplice pipe2 error:"<<errno;
+        pipe_[0] = pipe_[1] = -1;
+        finishFront(false);
+        return 0;
+    }
+    // 内部pipe空了才从源读 这样源端的EAGAIN一定是源没有数据 而不是pipe满了
+    if(pipeBytes_ == 0){
+        if(front.remaining == 0){
+            finishFront(true);
+            return 0;
+        }
+        ssize_t r = ::splice(front.fd, nullptr, pipe_[1], nullptr, std::min(front.remaining, kMaxSpliceChunk), SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if(r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+            blockedSource_ = front.fd;
+            return 0;
+        }
+        if(r <= 0){
+            if(r == 0) LOG_ERROR<<"OutputQueue::writeSplice unexpected EOF on fd="<<front.fd;
+            else LOG_ERROR<<"OutputQueue::writeSplice splice fd="<<front.fd<<" error:"<<errno;
+            finishFront(false);
+            return 0;
+        }
+        pipeBytes_ = r;
+        front.remaining -= r;
+    }
+    ssize_t n = ::splice(pipe_[0], nullptr, fd, nullptr, pipeBytes_, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if(n < 0){
+        *saveErrno = errno;
+        return -1;
+    }
+    pipeBytes_ -= n;
+    bytes_ -= n;
+    if(pipeBytes_ == 0 && front.remaining == 0) finishFront(true);
+    return n;
+}
+
+void OutputQueue::finishFront(bool ok){
+    Segment& front = segments_.front();
+    bytes_ -= front.remaining;
+    if(front.kind == kSplice && pipeBytes_ > 0){
+        // pipe中残留的数据已经不会再发送了 直接换一个新的pipe
+        bytes_ -= pipeBytes_;
+        closePipe();
+    }
+    if(front.done) completions_.emplace_back(std::move(front.done), ok);
+    segments_.pop_front();
+}
+
+std::vector<OutputQueue::Completion> OutputQueue::takeCompletions(){
+    std::vector<Completion> completions;
+    completions.swap(completions_);
+    return completions;
+}
+
+void OutputQueue::abandonBlockedSource(){
+    if(blockedSource_ < 0) return;
+    if(!segments_.empty() && segments_.front().kind == kSplice && segments_.front().fd == blockedSource_) finishFront(false);
+    blockedSource_ = -1;
+}
+
+void OutputQueue::abort(){
+    while(!segments_.empty()){
+        if(segments_.front().inMemory()){
+            bytes_ -= segments_.front().size();
+            segments_.pop_front();
+        }
+        else finishFront(false);
+    }
+    blockedSource_ = -1;
+}
+
+void OutputQueue::consume(size_t n){
+    bytes_ -= n;
+    while(n > 0 && !segments_.empty()){
+        Segment& front = segments_.front();
+        size_t size = front.size();
+        if(n < size){
+            if(front.kind == kSlice) front.slice.removePrefix(n);
+            else front.bytes.retrieve(n);
+            return;
+        }
+        n -= size;
+        segments_.pop_front(); // 拷贝数据段的存储随之归还给BufferPool
+    }
+}
+
+void OutputQueue::closePipe(){
+    if(pipe_[0] >= 0){
+        ::close(pipe_[0]);
+        ::close(pipe_[1]);
+    }
+    pipe_[0] = pipe_[1] = -1;
+    pipeBytes_ = 0;
+}
@@ -1,9 +1,24 @@
+#include<algorithm>
+
 #include<Poller.h>
 #include "Channel.h"
 
-Poller::Poller(EventLoop* loop) : ownerLoop_(loop){}
+Poller::Poller(EventLoop* loop) : channels_(64, nullptr), numChannels_(0), ownerLoop_(loop){}
 
 bool Poller::hasChannel(Channel* channel) const{
-    auto it = channels_.find(channel->fd());
-    return it != channels_.end() && it->second == channel;
-}
\ No newline at end of file
+    return channelOf(channel->fd()) == channel;
+}
+
+void Poller::addChannelEntry(Channel* channel){
+    const size_t fd = static_cast<size_t>(channel->fd());
+    if(fd >= channels_.size()) channels_.resize(std::max(channels_.size() * 2, fd + 1), nullptr);
+    if(channels_[fd] == nullptr) ++numChannels_;
+    channels_[fd] = channel;
+}
+
+void Poller::removeChannelEntry(int fd){
+    if(static_cast<size_t>(fd) < channels_.size() && channels_[fd] != nullptr){
+        channels_[fd] = nullptr;
+        --numChannels_;
+    }
+}
@@ -73,4 +73,14 @@ void Socket::setKeepAlive(bool on)
     // 这对于检测网络中失效的对等方非常有用。
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval));
-}
\ No newline at end of file
+}
+
+bool Socket::setZeroCopy(bool on)
+{
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+    // 允许sendmsg使用MSG_ZEROCOPY 完成通知通过socket错误队列返回
+    int optval = on ? 1 : 0;
+    return ::setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY, &optval, sizeof(optval)) == 0;
+}
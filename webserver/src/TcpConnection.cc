@@ -1,4 +1,5 @@
 #include <functional>
+#include <algorithm>
 #include <string>
 #include <errno.h>
 #include <sys/types.h>
@@ -14,6 +15,8 @@
 #include <Socket.h>
 #include <Channel.h>
 #include <EventLoop.h>
+#include <ConnectionReaper.h>
+#include <ZeroCopyHolder.h>
 
 static EventLoop* CheckLoopNotNull(EventLoop* loop){
     if(loop == nullptr) LOG_FATAL<<"mainloop is null!";
@@ -25,11 +28,17 @@ TcpConnection::TcpConnection(EventLoop* loop,const std::string& nameArg,int sock
     , name_(nameArg)
     , state_(kConnecting)
     , reading_(true)
+    , edgeTriggered_(false)
     , socket_(new Socket(sockfd))
     , channel_(new Channel(loop, sockfd))
+    , waitingSource_(false)
+    , sourceBorrowed_(false)
+    , sourceOwner_(nullptr)
     , localAddr_(localAddr)
     , peerAddr_(peerAddr)
     , highWaterMark_(64 * 1024 * 1024) // 64M
+    , pendingReaper_(nullptr)
+    , reaper_(nullptr)
 {
     // 下面给channel设置相应的回调函数 poller给channel通知感兴趣的事件发生了 channel会回调相应的回调函数
     channel_->setReadCallback(std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
@@ -37,30 +46,78 @@ TcpConnection::TcpConnection(EventLoop* loop,const std::string& nameArg,int sock
     channel_->setCloseCallback(std::bind(&TcpConnection::handleClose,this));
     channel_->setErrorCallback(std::bind(&TcpConnection::handleError,this));
 
-    LOG_INFO<<"TcpConnection::ctor:["<<name_.c_str()<<"]at fd="<<sockfd;
+    LOG_DEBUG<<"TcpConnection::ctor:["<<name_.c_str()<<"]at fd="<<sockfd;
     socket_->setKeepAlive(true);
 }
 
 TcpConnection::~TcpConnection(){
-    LOG_INFO<<"TcpConnection::dtor["<<name_.c_str()<<"]at fd="<<channel_->fd()<<"state="<<(int)state_;
+    LOG_DEBUG<<"TcpConnection::dtor["<<name_.c_str()<<"]at fd="<<channel_->fd()<<"state="<<(int)state_;
+}
+
+int TcpConnection::fd() const{
+    return socket_->fd();
+}
+
+void TcpConnection::setZeroCopyThreshold(size_t bytes){
+    if(bytes > 0 && !socket_->setZeroCopy(true)){
+        LOG_ERROR<<"TcpConnection::setZeroCopyThreshold SO_ZEROCOPY not supported, fd="<<socket_->fd();
+        bytes = 0;
+    }
+    outputQueue_.setZeroCopyThreshold(bytes);
+}
+
+void TcpConnection::setEdgeTriggered(bool on){
+    edgeTriggered_ = on;
+    channel_->setEdgeTriggered(on);
 }
 
 void TcpConnection::send(const std::string& buf){
     if(state_ == kConnected){
         if(loop_->isInLoopThread()) sendInLoop(buf.c_str(),buf.size());
-        else loop_->runInLoop(std::bind(&TcpConnection::sendInLoop, this,buf.c_str(),buf.size()));
+        else send(Slice::copyOf(buf.data(),buf.size())); // buf在返回后可能就被释放了 必须拷贝
+    }
+}
+
+void TcpConnection::send(std::string&& buf){
+    if(state_ == kConnected){
+        // 在loop线程中 小数据没写完时拷贝剩余部分更便宜 大数据按引用排队
+        if(loop_->isInLoopThread() && buf.size() < OutputQueue::kMaxCopySegment) sendInLoop(buf.data(),buf.size());
+        else send(Slice(std::move(buf)));
+    }
+}
+
+void TcpConnection::send(Buffer&& buf){
+    if(state_ == kConnected){
+        if(loop_->isInLoopThread() && buf.readableBytes() < OutputQueue::kMaxCopySegment){
+            sendInLoop(buf.peek(),buf.readableBytes());
+            buf.retrieveAll();
+        }
+        else send(Slice(std::move(buf)));
+    }
+}
+
+void TcpConnection::send(const Slice& slice){
+    if(state_ == kConnected){
+        if(loop_->isInLoopThread()) sendSliceInLoop(slice);
+        else loop_->runInLoop(std::bind(&TcpConnection::sendSliceInLoop,shared_from_this(),slice));
     }
 }
+
+void TcpConnection::sendSliceInLoop(const Slice& slice){
+    sendInLoop(slice.data(),slice.size(),&slice);
+}
 /**
  * 发送数据 应用写的快 而内核发送数据慢 需要把待发送数据写入缓冲区，而且设置了水位回调
  **/
-void TcpConnection::sendInLoop(const void* data,size_t len){
+void TcpConnection::sendInLoop(const void* data,size_t len,const Slice* slice){
     ssize_t nwrote = 0;
     size_t remaining = len;
     bool faultError = false;
 
     if(state_ == kDisconnected) LOG_ERROR<<"disconnected, give up writing";
-    if(!channel_->isWriting() && outputBuffer_.readableBytes() == 0){
+    // 要走MSG_ZEROCOPY的大Slice不在这里直接write 交给发送队列
+    bool zeroCopy = slice && outputQueue_.zeroCopyEnabled() && len >= outputQueue_.zeroCopyThreshold();
+    if(!channel_->isWriting() && outputQueue_.empty() && !zeroCopy){
         nwrote = ::write(channel_->fd(),data,len);
         if(nwrote>=0){
             remaining = len - nwrote;
@@ -81,16 +138,22 @@ void TcpConnection::sendInLoop(const void* data,size_t len){
      * 然后给channel注册EPOLLOUT事件，Poller发现tcp的发送缓冲区有空间后会通知
      * 相应的sock->channel，调用channel对应注册的writeCallback_回调方法，
      * channel的writeCallback_实际上就是TcpConnection设置的handleWrite回调，
-     * 把发送缓冲区outputBuffer_的内容全部发送完成
+     * 把发送队列outputQueue_的内容全部发送完成
      **/
     if(!faultError&&remaining>0){
         // 目前发送缓冲区剩余的待发送的数据的长度
-        size_t oldlen = outputBuffer_.readableBytes();
+        size_t oldlen = outputQueue_.readableBytes();
         if(oldlen + remaining >= highWaterMark_ && oldlen < highWaterMark_ && highWaterMarkCallback_){
             loop_->queueInLoop(std::bind(highWaterMarkCallback_,shared_from_this(),oldlen+remaining));
         }
-        outputBuffer_.append((char*)data + nwrote, remaining);
-        if(!channel_->isWriting()) channel_->enableWriting();// 这里一定要注册channel的写事件 否则poller不会给channel通知epollout
+        // 数据来自Slice时剩余部分按引用排队 否则拷贝进发送队列
+        if(slice) outputQueue_.append(slice->subslice(nwrote, remaining));
+        else outputQueue_.append((const char*)data + nwrote, remaining);
+        if(!channel_->isWriting() && !waitingSource_){
+            channel_->enableWriting();// 这里一定要注册channel的写事件 否则poller不会给channel通知epollout
+            // 零拷贝的数据还没尝试过发送 立即发一次 不必等EPOLLOUT
+            if(zeroCopy) handleWrite();
+        }
     }
 }
 
@@ -102,8 +165,20 @@ void TcpConnection::shutdown(){
 }
 
 void TcpConnection::shutdownInLoop(){
-    // 说明当前outputBuffer_的数据全部向外发送完成
-    if(!channel_->isWriting()) socket_->shutdownWrite();
+    // 说明当前outputQueue_的数据全部向外发送完成
+    if(!channel_->isWriting() && outputQueue_.empty()) socket_->shutdownWrite();
+}
+
+void TcpConnection::forceClose(){
+    if(state_ == kConnected || state_ == kDisconnecting){
+        setState(kDisconnecting);
+        loop_->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+    }
+}
+
+void TcpConnection::forceCloseInLoop(){
+    // 丢弃未发送的数据 走和对端关闭相同的流程
+    if(state_ == kConnected || state_ == kDisconnecting) handleClose();
 }
 
 //建立连接
@@ -111,12 +186,22 @@ void TcpConnection::connectEstablished(){
     setState(kConnected);
     channel_->tie(shared_from_this());
     channel_->enableReading(); // 向poller注册channel的EPOLLIN读事件
+    if(pendingReaper_) pendingReaper_->add(this);
 
     // 新连接建立，执行回调
     connectionCallback_(shared_from_this());
 }
 //连接销毁
 void TcpConnection::connectDestroyed(){
+    if(reaper_) reaper_->remove(this);
+    stopWaitingSource();
+    outputQueue_.abort();
+    dispatchFileCompletions();
+    // 内核可能还在发送零拷贝的页 交给loop的ZeroCopyHolder等完成通知之后再释放
+    if(outputQueue_.zeroCopyEnabled()){
+        outputQueue_.reapZeroCopy(socket_->fd());
+        if(outputQueue_.zeroCopyPinnedBytes() > 0) loop_->zeroCopyHolder()->adopt(socket_->fd(), outputQueue_.takeZeroCopyPinned());
+    }
     if(state_ == kConnected){
         setState(kConnected);
         setState(kDisconnected);
@@ -128,12 +213,39 @@ void TcpConnection::connectDestroyed(){
 void TcpConnection::handleRead(Timestamp receiveTime){
     int saveErrno = 0;
     ssize_t n = inputBuffer_.readFd(channel_->fd(),&saveErrno);
+    bool peerClosed = false;
+    // 边沿触发模式下必须把socket读到EAGAIN为止 否则剩余的数据不会再次通知
+    if(edgeTriggered_ && n>0){
+        ssize_t more = 0;
+        while((more = inputBuffer_.readFd(channel_->fd(),&saveErrno))>0) n += more;
+        if(more == 0) peerClosed = true; // 数据之后紧跟着对端关闭
+        else if(saveErrno == EAGAIN || saveErrno == EWOULDBLOCK) saveErrno = 0;
+    }
     if(n>0) // 有数据到达
     {
+        if(reaper_) reaper_->touch(this, receiveTime);
         // 已建立连接的用户有可读事件发生了 调用用户传入的回调操作onMessage shared_from_this就是获取了TcpConnection的智能指针
         messageCallback_(shared_from_this(),&inputBuffer_,receiveTime);
+        if(peerClosed) handleClose();
+        else if(saveErrno == ENOBUFS){
+            // 边沿触发下读到了接收缓冲区的上限 socket里还有数据但不会再通知
+            if(inputBuffer_.full()) closeOnFullBuffer();
+            else loop_->queueInLoop([self = shared_from_this(), receiveTime](){
+                if(self->state_ != kDisconnected && self->reading_) self->handleRead(receiveTime);
+            });
+        }
+        else if(saveErrno != 0){
+            errno = saveErrno;
+            LOG_ERROR<<"TcpConnection::handleRead";
+            handleError();
+        }
     }else if(n == 0){
         handleClose();
+    }else if(saveErrno == ENOBUFS){
+        // 上一次回调没有取走数据 接收缓冲区仍是满的
+        closeOnFullBuffer();
+    }else if(edgeTriggered_ && (saveErrno == EAGAIN || saveErrno == EWOULDBLOCK)){
+        // 边沿触发下的虚假唤醒 数据已经被读完
     }else{
         errno = saveErrno;
         LOG_ERROR<<"TcpConnection::handleRead";
@@ -144,18 +256,28 @@ void TcpConnection::handleRead(Timestamp receiveTime){
 void TcpConnection::handleWrite(){
     if(channel_->isWriting()){
         int savedErrno = 0;
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(),&savedErrno);
-        if(n>0){
-            outputBuffer_.retrieve(n);//从缓冲区读取reable区域的数据移动readindex下标
-            if(outputBuffer_.readableBytes() == 0){
-                channel_->disableWriting();
-                if(writeCompleteCallback_){
-                    //TcpConnection对象在其所在的subloop中 向pendingFunctors_中加入回调
-                    loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
-                }
-                if(state_ == kDisconnecting) shutdownInLoop(); // 在当前所属的loop中把TcpConnection删除掉
+        // 队首是内存数据时writev一次发送多个数据段 是文件时sendfile/splice 已发送的部分由writeFd从队列中移除
+        // 返回0表示队首的文件段结束了或splice源暂时没有数据
+        ssize_t n = outputQueue_.writeFd(channel_->fd(),&savedErrno);
+        bool wrote = n>0;
+        // 边沿触发模式下一直写到队列清空或内核发送缓冲区写满(EAGAIN)
+        while(edgeTriggered_ && n>=0 && !outputQueue_.empty() && outputQueue_.blockedSourceFd()<0){
+            n = outputQueue_.writeFd(channel_->fd(),&savedErrno);
+            if(n>0) wrote = true;
+        }
+        dispatchFileCompletions();
+        if(wrote && reaper_) reaper_->touch(this, loop_->pollReturnTime());
+
+        if(outputQueue_.blockedSourceFd()>=0){
+            waitSpliceSource(outputQueue_.blockedSourceFd());
+        }else if(outputQueue_.empty()){
+            channel_->disableWriting();
+            if(writeCompleteCallback_){
+                //TcpConnection对象在其所在的subloop中 向pendingFunctors_中加入回调
+                loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
             }
-        }else{
+            if(state_ == kDisconnecting) shutdownInLoop(); // 在当前所属的loop中把TcpConnection删除掉
+        }else if(n<0){
             LOG_DEBUG<<"TcpConnection::handleWrite";
         }
     }else{
@@ -163,59 +285,194 @@ void TcpConnection::handleWrite(){
     }
 }
 
+void TcpConnection::dispatchFileCompletions(){
+    for(auto& completion : outputQueue_.takeCompletions()){
+        loop_->queueInLoop(std::bind(completion.first, shared_from_this(), completion.second));
+    }
+}
+
+void TcpConnection::waitSpliceSource(int srcFd){
+    channel_->disableWriting();
+    waitingSource_ = true;
+    // 源fd已经由本loop上别的Channel登记(比如作为源的另一条连接) 再注册一个Channel会覆盖它的登记 改为借用它的可读通知
+    Channel* owner = loop_->channelOf(srcFd);
+    if(owner != nullptr && owner != sourceChannel_.get()){
+        sourceBorrowed_ = true;
+        sourceOwner_ = owner;
+        std::weak_ptr<TcpConnection> weakThis(shared_from_this());
+        owner->setReadableHook([weakThis](bool removed){
+            TcpConnectionPtr conn = weakThis.lock();
+            if(conn) conn->handleBorrowedSource(removed);
+        });
+        return;
+    }
+    if(!sourceChannel_ || sourceChannel_->fd() != srcFd){
+        sourceChannel_.reset(new Channel(loop_, srcFd));
+        sourceChannel_->setReadCallback(std::bind(&TcpConnection::handleSourceReadable, this));
+        // 写端关闭的pipe只会报告EPOLLHUP 同样交给splice去读出EOF
+        sourceChannel_->setCloseCallback(std::bind(&TcpConnection::handleSourceReadable, this));
+        sourceChannel_->setErrorCallback(std::bind(&TcpConnection::handleSourceReadable, this));
+        sourceChannel_->tie(shared_from_this());
+    }
+    sourceChannel_->enableReading();
+}
+
+void TcpConnection::handleSourceReadable(){
+    if(!waitingSource_) return;
+    stopWaitingSource();
+    // 边沿触发模式下EPOLLOUT一直处于注册状态 不会再来新的边沿 直接尝试发送
+    channel_->enableWriting();
+    handleWrite();
+}
+
+void TcpConnection::handleBorrowedSource(bool removed){
+    if(!removed){
+        handleSourceReadable();
+        return;
+    }
+    // 源Channel已从Poller删除(所属连接正在销毁 fd随后会被关闭) hook已被它清掉 不能再访问它
+    // 这一段splice以失败结束 不能自己再注册这个fd
+    sourceOwner_ = nullptr;
+    if(!waitingSource_) return;
+    stopWaitingSource();
+    outputQueue_.abandonBlockedSource();
+    dispatchFileCompletions();
+    channel_->enableWriting();
+    handleWrite();
+}
+
+void TcpConnection::stopWaitingSource(){
+    if(!waitingSource_) return;
+    waitingSource_ = false;
+    if(sourceBorrowed_){
+        if(sourceOwner_) sourceOwner_->setReadableHook(Channel::ReadableHook());
+        sourceOwner_ = nullptr;
+        sourceBorrowed_ = false;
+        return;
+    }
+    sourceChannel_->disableAll();
+    sourceChannel_->remove();
+}
+
 void TcpConnection::handleClose(){
     LOG_INFO<<"TcpConnection::handleClose fd="<<channel_->fd()<<"state="<<(int)state_;
     setState(kDisconnected);
     channel_->disableAll();
+    // 没发完的文件/splice以失败结束 让用户有机会关闭源fd
+    stopWaitingSource();
+    outputQueue_.abort();
+    dispatchFileCompletions();
 
     TcpConnectionPtr connPtr(shared_from_this());
     connectionCallback_(connPtr); //连接回调
     closeCallback_(connPtr);// 执行关闭连接的回调 执行的是TcpServer::removeConnection回调方法, must be the last line
 }
 
+void TcpConnection::closeOnFullBuffer(){
+    LOG_EVERY_T(ERROR, 1.0)<<"TcpConnection::handleRead ["<<name_.c_str()<<"] input buffer reached "<<inputBuffer_.readableBytes()<<" bytes, closing";
+    handleClose();
+}
+
 void TcpConnection::handleError(){
+    // MSG_ZEROCOPY的完成通知放在socket错误队列里 同样以EPOLLERR上报
+    int reaped = outputQueue_.zeroCopyEnabled() ? outputQueue_.reapZeroCopy(channel_->fd()) : 0;
     int optval;
     socklen_t optlen = sizeof optval;
     int err = 0;
     if(::getsockopt(channel_->fd(),SOL_SOCKET,SO_ERROR,&optval,&optlen)<0) err = errno;
     else err = optval;
-    LOG_ERROR<<"TcpConnection::handleError name:"<<name_.c_str()<<"- SO_ERROR:%"<<err;
+    if(reaped > 0 && err == 0) return;
+    // 对端异常时可能每轮都报错 所有连接共用这一个限流点
+    LOG_EVERY_T(ERROR, 1.0)<<"TcpConnection::handleError name:"<<name_.c_str()<<"- SO_ERROR:%"<<err;
+}
+
+void TcpConnection::startRead(){
+    loop_->runInLoop(std::bind(&TcpConnection::startReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::stopRead(){
+    loop_->runInLoop(std::bind(&TcpConnection::stopReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::startReadInLoop(){
+    if(state_ == kDisconnected) return;
+    if(!reading_ || !channel_->isReading()){
+        channel_->enableReading();
+        reading_ = true;
+    }
+}
+
+void TcpConnection::stopReadInLoop(){
+    if(state_ == kDisconnected) return;
+    if(reading_ || channel_->isReading()){
+        channel_->disableReading();
+        reading_ = false;
+    }
 }
 
 //零拷贝发送函数
-void TcpConnection::sendFile(int fileDescriptor,off_t offset,size_t count){
+void TcpConnection::sendFile(int fileDescriptor,off_t offset,size_t count,const FileCompleteCallback& cb){
     if(connected()){
         // 判断当前线程是否是loop循环的线程
-        if(loop_->isInLoopThread()) sendFileInLoop(fileDescriptor,offset,count);
+        if(loop_->isInLoopThread()) sendFileInLoop(fileDescriptor,offset,count,cb);
         // 如果不是，则唤醒运行这个TcpConnection的线程执行Loop循环
-        else loop_->runInLoop(std::bind(&TcpConnection::sendFileInLoop,shared_from_this(),fileDescriptor,offset,count));
+        else loop_->runInLoop(std::bind(&TcpConnection::sendFileInLoop,shared_from_this(),fileDescriptor,offset,count,cb));
     }else LOG_ERROR<<"TcpConnection::sendFile - not connected";
 }
 
 // 在事件循环中执行sendfile
-void TcpConnection::sendFileInLoop(int fileDescriptor,off_t offset, size_t count){
+void TcpConnection::sendFileInLoop(int fileDescriptor,off_t offset, size_t count,const FileCompleteCallback& cb){
     ssize_t bytesSent = 0; //发送了多少字节数
     size_t remaining = count; // 剩余需要发送的数据
     bool faultError = false; // 错误的标志位
 
-    if(state_ == kDisconnecting){
+    if(state_ == kDisconnected){
         LOG_ERROR<<"disconnected, give up writing";
+        if(cb) loop_->queueInLoop(std::bind(cb,shared_from_this(),false));
         return;
     }
-    // 表示Channel第一次开始写数据或者outputBuffer缓冲区中没有数据
-    if(!channel_->isWriting() && outputBuffer_.readableBytes() == 0){
-        bytesSent = sendfile(socket_->fd(),fileDescriptor,&offset,remaining);
+    // 表示Channel第一次开始写数据或者发送队列中没有数据 可以直接发送
+    if(!channel_->isWriting() && outputQueue_.empty() && remaining > 0){
+        bytesSent = sendfile(socket_->fd(),fileDescriptor,&offset,std::min(remaining, OutputQueue::kMaxFileChunk));
         if(bytesSent >= 0){
             remaining -= bytesSent;
-            if(remaining == 0 && writeCompleteCallback_){
-                // remaining为0意味着数据正好全部发送完，就不需要给其设置写事件的监听
-                loop_->queueInLoop(std::bind(writeCompleteCallback_,shared_from_this()));
-            }
         }else{
             if(errno != EWOULDBLOCK) LOG_ERROR<<"TcpConnection::sendFileInLoop";
             if(errno == EPIPE || errno == ECONNRESET) faultError = true;
         }
     }
-    // 处理剩余数据
-    if(!faultError && remaining > 0) loop_->queueInLoop(std::bind(&TcpConnection::sendFileInLoop,shared_from_this(),fileDescriptor,offset,remaining));
+    if(faultError){
+        if(cb) loop_->queueInLoop(std::bind(cb,shared_from_this(),false));
+        return;
+    }
+    if(remaining == 0){
+        // remaining为0意味着数据正好全部发送完，就不需要给其设置写事件的监听
+        if(cb) loop_->queueInLoop(std::bind(cb,shared_from_this(),true));
+        if(writeCompleteCallback_ && outputQueue_.empty()) loop_->queueInLoop(std::bind(writeCompleteCallback_,shared_from_this()));
+        return;
+    }
+    // 剩余的部分排进发送队列 等EPOLLOUT时由handleWrite继续 而不是反复投递自己空转
+    outputQueue_.appendFile(fileDescriptor,offset,remaining,cb);
+    if(!channel_->isWriting() && !waitingSource_) channel_->enableWriting();
+}
+
+void TcpConnection::sendSplice(int srcFd,size_t count,const FileCompleteCallback& cb){
+    if(connected()){
+        if(loop_->isInLoopThread()) sendSpliceInLoop(srcFd,count,cb);
+        else loop_->runInLoop(std::bind(&TcpConnection::sendSpliceInLoop,shared_from_this(),srcFd,count,cb));
+    }else LOG_ERROR<<"TcpConnection::sendSplice - not connected";
+}
+
+void TcpConnection::sendSpliceInLoop(int srcFd,size_t count,const FileCompleteCallback& cb){
+    if(state_ == kDisconnected){
+        LOG_ERROR<<"disconnected, give up writing";
+        if(cb) loop_->queueInLoop(std::bind(cb,shared_from_this(),false));
+        return;
+    }
+    outputQueue_.appendSplice(srcFd,count,cb);
+    // 和其他数据统一由handleWrite按队列顺序发送
+    if(!channel_->isWriting() && !waitingSource_){
+        channel_->enableWriting();
+        handleWrite();
+    }
 }
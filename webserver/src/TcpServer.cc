@@ -1,4 +1,5 @@
 #include <functional>
+#include <future>
 #include <string.h>
 
 #include "TcpServer.h"
@@ -10,25 +11,69 @@ static EventLoop* CheckLoopNotNull(EventLoop* loop){
     return loop;
 }
 
+// 在loop线程中执行cb并等它执行完
+static void runInLoopAndWait(EventLoop* loop, const std::function<void()>& cb){
+    if(loop->isInLoopThread()){
+        cb();
+        return;
+    }
+    std::promise<void> done;
+    loop->runInLoop([&cb, &done](){
+        cb();
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
 TcpServer::TcpServer(EventLoop* loop, const InetAddress& listenAddr,const std::string& nameArg,Option option)
     : loop_(CheckLoopNotNull(loop))
     , ipPort_(listenAddr.toIpPort())
     , name_(nameArg)
-    , acceptor_(new Acceptor(loop,listenAddr, option == kReusePort))
+    , listenAddr_(listenAddr)
+    , option_(option)
+    , acceptor_(option != kReusePortPerLoop ? new Acceptor(loop,listenAddr, option != kNoReusePort) : nullptr)
     , threadPool_(new EventLoopThreadPool(loop, name_))
     , connectionCallback_()
     , messageCallback_()
+    , edgeTriggered_(false)
+    , idleTimeout_(0)
+    , maxConnectionLifetime_(0)
+    , bufferMaxIdleCapacity_(0)
+    , bufferMaxSize_(0)
+    , adaptiveReadSize_(false)
+    , zeroCopyThreshold_(0)
     , nextConnId_(1)
     , started_(0){
     // 当有新用户连接时，Acceptor类中绑定的acceptChannel_会有读事件发生，执行handleRead()调用TcpServer::newConnection回调
-    acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this, std::placeholders::_1, std::placeholders::_2));
+    // kReusePortPerLoop模式下由各subloop的Acceptor监听 只有没有subloop时才在start中创建这个Acceptor
+    if(acceptor_) acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this, std::placeholders::_1, std::placeholders::_2));
 }
 TcpServer::~TcpServer(){
-    for(auto &item:connections_){
+    // kReusePortPerLoop: subloop的Acceptor要在其所属的loop线程中注销channel
+    // 同步等待删除完成 之后不会再有accept在subloop中调用createConnection
+    for(auto &acceptor:loopAcceptors_){
+        runInLoopAndWait(acceptor->getLoop(), [&acceptor](){ acceptor.reset(); });
+    }
+    const bool perLoop = !loopAcceptors_.empty();
+    loopAcceptors_.clear();
+
+    ConnectionMap connections;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connections.swap(connections_);
+    }
+    for(auto &item:connections){
         TcpConnectionPtr conn(item.second);
         item.second.reset();// 把原始的智能指针复位 让栈空间的TcpConnectionPtr conn指向该对象 当conn出了其作用域 即可释放智能指针指向的对象
         //注销链接
-        conn->getLoop()->runInLoop(std::bind(&TcpConnection::connectDestroyed,conn));
+        // 各subloop自己调用removeConnectionInLoop(会访问this) 等connectDestroyed执行完 之前排队的移除也都已经执行
+        if(perLoop) runInLoopAndWait(conn->getLoop(), std::bind(&TcpConnection::connectDestroyed,conn));
+        else conn->getLoop()->runInLoop(std::bind(&TcpConnection::connectDestroyed,conn));
+    }
+    // reaper的定时器和链表只能在所属loop线程中操作 排在上面的connectDestroyed之后释放
+    for(auto &item:reapers_){
+        ConnectionReaper* ptr = item.second.release();
+        item.first->runInLoop([ptr](){ delete ptr; });
     }
 }
 // 设置底层subloop的个数
@@ -41,16 +86,39 @@ void TcpServer::setThreadNum(int numThreads){
 void TcpServer::start(){
     if(started_.fetch_add(1) == 0){
         threadPool_->start(threadInitCallback_); //启用底层loop线程池
-        loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+        std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+        if(idleTimeout_ > 0 || maxConnectionLifetime_ > 0){
+            for(EventLoop* ioLoop : loops) reapers_[ioLoop].reset(new ConnectionReaper(ioLoop, idleTimeout_, maxConnectionLifetime_));
+        }
+        if(option_ == kReusePortPerLoop && loops.front() != loop_){
+            // 每个subloop在同一端口上各自监听 新连接由内核分配 接收后不再跨线程转交
+            for(EventLoop* ioLoop : loops){
+                std::unique_ptr<Acceptor> acceptor(new Acceptor(ioLoop, listenAddr_, true));
+                acceptor->setNewConnectionCallback(std::bind(&TcpServer::createConnection, this, ioLoop, std::placeholders::_1, std::placeholders::_2));
+                ioLoop->runInLoop(std::bind(&Acceptor::listen, acceptor.get()));
+                loopAcceptors_.push_back(std::move(acceptor));
+            }
+        }
+        else{
+            if(!acceptor_){
+                // kReusePortPerLoop但没有subloop 退回由baseloop监听
+                acceptor_.reset(new Acceptor(loop_, listenAddr_, true));
+                acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this, std::placeholders::_1, std::placeholders::_2));
+            }
+            loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+        }
     }
 }
 
 void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr){
-    //轮询算法 选择一个subloop来管理connfd对应的channel
-    EventLoop* ioLoop = threadPool_->getNextLoop();
+    //按选择策略(默认轮询) 选择一个subloop来管理connfd对应的channel
+    EventLoop* ioLoop = threadPool_->getNextLoop(peerAddr);
+    createConnection(ioLoop, sockfd, peerAddr);
+}
+
+void TcpServer::createConnection(EventLoop* ioLoop, int sockfd, const InetAddress& peerAddr){
     char buf[64] = {0};
-    snprintf(buf, sizeof buf,"-%s#%d", ipPort_.c_str(),nextConnId_);
-    ++nextConnId_; // 这里没有设置为原子类是因为其只在mainloop中执行 不涉及线程安全问题
+    snprintf(buf, sizeof buf,"-%s#%d", ipPort_.c_str(),nextConnId_.fetch_add(1)); // kReusePortPerLoop模式下会在多个subloop中并发执行
     std::string connName = name_ + buf;
 
     LOG_INFO<<"TcpServer::nawConnection ["<<name_.c_str()<<"]- new connection ["<<connName.c_str()<<"]from "<<peerAddr.toIpPort().c_str();
@@ -63,11 +131,22 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr){
 
     InetAddress localAddr(local);
     TcpConnectionPtr conn(new TcpConnection(ioLoop,connName,sockfd,localAddr,peerAddr));
-    connections_[connName] = conn;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connections_[connName] = conn;
+    }
+    ioLoop->incrConnectionCount(); // 维护每个loop的活跃连接数 供负载感知的选择策略使用
     // 下面的回调都是用户设置给TcpServer => TcpConnection的，至于Channel绑定的则是TcpConnection设置的四个，handleRead,handleWrite... 这下面的回调用于handlexxx函数中
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setEdgeTriggered(edgeTriggered_);
+    conn->setBufferMaxIdleCapacity(bufferMaxIdleCapacity_);
+    conn->setAdaptiveReadSize(adaptiveReadSize_);
+    if(bufferMaxSize_ > 0) conn->setBufferMaxSize(bufferMaxSize_);
+    if(zeroCopyThreshold_ > 0) conn->setZeroCopyThreshold(zeroCopyThreshold_);
+    auto reaper = reapers_.find(ioLoop);
+    if(reaper != reapers_.end()) conn->setReaper(reaper->second.get());
 
     // 设置了如何关闭连接的回调
     conn->setCloseCallback(std::bind(&TcpServer::removeConnection, this, std::placeholders::_1));
@@ -75,12 +154,18 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr){
 }
 
 void TcpServer::removeConnection(const TcpConnectionPtr& conn){
-    loop_->runInLoop(std::bind(&TcpServer::removeConnectionInLoop,this,conn));
+    // kReusePortPerLoop模式下连接的整个生命周期都留在它自己的subloop中
+    EventLoop* loop = (option_ == kReusePortPerLoop) ? conn->getLoop() : loop_;
+    loop->runInLoop(std::bind(&TcpServer::removeConnectionInLoop,this,conn));
 }
 
 void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn){
     LOG_INFO<<"TcpServer::removeConnectionInLoop ["<<name_.c_str()<<"] - connection %s"<<conn->name().c_str();
-    connections_.erase(conn->name());
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connections_.erase(conn->name());
+    }
     EventLoop* ioLoop = conn->getLoop();
+    ioLoop->decrConnectionCount();
     ioLoop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
 }
\ No newline at end of file
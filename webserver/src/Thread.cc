@@ -2,6 +2,7 @@
 #include "CurrentThread.h"
 
 #include <semaphore.h>
+#include <pthread.h>
 
 std::atomic_int Thread::numCreated_(0);
 
@@ -21,6 +22,8 @@ void Thread::start(){ // 一个Thread对象 记录的就是一个新线程的详
     // 开启新线程,使用lambda按引用捕获所有外部变量
     thread_ = std::shared_ptr<std::thread>(new std::thread([&](){
         tid_ = CurrentThread::tid();// 获取线程的tid值
+        // 给线程命名 便于top -H、perf等工具区分各个loop线程 内核限制最长15个字符
+        ::pthread_setname_np(::pthread_self(), name_.substr(0, 15).c_str());
         sem_post(&sem);//增加信号量的值（从0变成1）表示准备好了
         func_();// 开启一个新线程 专门执行该线程函数
     }));
@@ -0,0 +1,75 @@
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#include "ThreadAffinity.h"
+#include "Logger.h"
+
+namespace ThreadAffinity
+{
+    bool bindToCpus(const std::vector<int>& cpus){
+        if(cpus.empty()) return false;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for(int cpu : cpus){
+            if(cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+        }
+        // pid为0表示当前线程
+        if(::sched_setaffinity(0, sizeof(set), &set) != 0){
+            LOG_ERROR<<"sched_setaffinity error:"<<errno;
+            return false;
+        }
+        return true;
+    }
+
+    bool preferMemoryNode(int node){
+        if(node < 0 || node >= static_cast<int>(sizeof(unsigned long) * 8)) return false;
+        unsigned long mask = 1UL << node;
+        // MPOL_PREFERRED只作用于调用线程 本节点内存不足时仍可回退到其他节点
+        if(::syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, sizeof(mask) * 8 + 1) != 0){
+            LOG_ERROR<<"set_mempolicy error:"<<errno;
+            return false;
+        }
+        return true;
+    }
+
+    std::vector<int> cpusOfNode(int node){
+        std::vector<int> cpus;
+        char path[64] = {0};
+        snprintf(path, sizeof path, "/sys/devices/system/node/node%d/cpulist", node);
+        FILE* fp = ::fopen(path, "re");
+        if(fp == nullptr) return cpus;
+        // 格式形如 0-3,8-11
+        char buf[1024] = {0};
+        if(::fgets(buf, sizeof buf, fp)){
+            char* p = buf;
+            while(*p && *p != '\n'){
+                char* end = nullptr;
+                long first = ::strtol(p, &end, 10);
+                if(end == p) break;
+                long last = first;
+                p = end;
+                if(*p == '-'){
+                    last = ::strtol(p + 1, &end, 10);
+                    p = end;
+                }
+                for(long cpu = first; cpu <= last; ++cpu) cpus.push_back(static_cast<int>(cpu));
+                if(*p == ',') ++p;
+            }
+        }
+        ::fclose(fp);
+        return cpus;
+    }
+
+    void apply(const ThreadPlacement& placement){
+        std::vector<int> cpus = placement.cpus;
+        // 只指定了NUMA节点时 绑定到该节点的全部cpu
+        if(cpus.empty() && placement.numaNode >= 0) cpus = cpusOfNode(placement.numaNode);
+        if(!cpus.empty()) bindToCpus(cpus);
+        if(placement.numaNode >= 0) preferMemoryNode(placement.numaNode);
+    }
+}
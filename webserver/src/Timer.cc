@@ -1,8 +1,25 @@
 #include "Timer.h"
 
+std::atomic<int64_t> Timer::s_numCreated_(0);
+
 void Timer::restart(Timestamp now){
     // 如果是重复定时事件，则继续添加定时事件，得到新事件到期事件
     if(repeat_) expiration_ = addTime(now, interval_);
     // 否则则延长时间
     else expiration_ = Timestamp();
-}
\ No newline at end of file
+}
+
+void Timer::reset(TimerCallback cb, Timestamp when, double interval){
+    callback_ = std::move(cb);
+    expiration_ = when;
+    interval_ = interval;
+    repeat_ = interval > 0.0;
+    sequence_ = ++s_numCreated_;
+    canceled_ = false;
+}
+
+void Timer::release(){
+    callback_ = nullptr;
+    sequence_ = 0;
+    canceled_ = false;
+}
@@ -25,33 +25,76 @@ TimerQueue::TimerQueue(EventLoop* loop)
 :loop_(loop),
 timerfd_(createTimerfd()),
 timerfdChannel_(loop_,timerfd_),
-timers_(){
+currentTick_(Timestamp::now().microSecondsSinceEpoch() / kTickMicroSeconds),
+armedTick_(UINT64_MAX),
+count_(0),
+callingExpiredTimers_(false){
     // 将 TimerQueue::handleRead 成员函数绑定为 timerfdChannel_ 的读事件回调
     timerfdChannel_.setReadCallback(std::bind(&TimerQueue::handleRead,this));
     timerfdChannel_.enableReading();
 }
 
+static void deleteSlot(TimerLink& slot){
+    while(slot.linked()){
+        Timer* timer = static_cast<Timer*>(slot.next);
+        timer->unlink();
+        delete timer;
+    }
+}
+
 TimerQueue::~TimerQueue(){
     timerfdChannel_.disableAll();
     timerfdChannel_.remove();
     ::close(timerfd_);
     // 删除所有定时器
-    for(const Entry& timer : timers_) delete timer.second;
+    for(TimerLink& slot : root_) deleteSlot(slot);
+    for(auto& level : levels_){
+        for(TimerLink& slot : level) deleteSlot(slot);
+    }
+    for(Timer* timer : freeTimers_) delete timer;
 }
 
-void TimerQueue::addTimer(TimerCallback cb,Timestamp when,double interval){
-    Timer* timer = new Timer(std::move(cb),when,interval);
+TimerId TimerQueue::addTimer(TimerCallback cb,Timestamp when,double interval){
+    Timer* timer = newTimer(std::move(cb),when,interval);
+    TimerId id(timer, timer->sequence());
     //等价于：loop_->runInLoop([this, timer]() { 
     //          this->addTimerInLoop(timer); 
     //       });
     loop_ ->runInLoop(std::bind(&TimerQueue::addTimerInLoop,this,timer));
+    return id;
+}
+
+void TimerQueue::cancel(TimerId timerId){
+    loop_->runInLoop(std::bind(&TimerQueue::cancelInLoop,this,timerId));
 }
 
 void TimerQueue::addTimerInLoop(Timer* timer){
-    // 是否取代了最早的定时触发时间
-    bool earliestChanged = insert(timer);
-    // 我们需要重新设置timerfd_触发时间
-    if(earliestChanged) resetTimerfd(timerfd_, timer->expiration());
+    // 跨线程添加时 定时器可能在加入时间轮之前就被取消了
+    if(timer->canceled()){
+        freeTimer(timer);
+        return;
+    }
+    uint64_t wake = insert(timer);
+    // 比timerfd_当前设置的时间更早才需要重新设置
+    if(wake < armedTick_){
+        armedTick_ = wake;
+        resetTimerfd(timerfd_, Timestamp(static_cast<int64_t>(wake) * kTickMicroSeconds));
+    }
+}
+
+void TimerQueue::cancelInLoop(TimerId timerId){
+    Timer* timer = timerId.timer_;
+    // 序号对不上说明定时器已经结束并被回收
+    if(timer == nullptr || timer->sequence() != timerId.sequence_) return;
+    if(timer->linked()){
+        // 还在时间轮中 直接摘除 timerfd_保持不变 到时空转一次即可
+        timer->unlink();
+        --count_;
+        freeTimer(timer);
+    }else{
+        // 正在执行的到期定时器(例如在自己的回调中取消) 或者尚未加入时间轮
+        timer->cancel();
+    }
 }
 
 // 重置timerfd
@@ -79,62 +122,165 @@ void ReadTimerFd(int timerfd){
     if(readn != sizeof(read_byte)) LOG_ERROR << "TimerQueue::ReadTimerFd read_size < 0";
 }
 
-// 返回删除的定时器节点 （std::vector<Entry> expired）
-std::vector<TimerQueue::Entry> TimerQueue::getExpired(Timestamp now){
-    std::vector<Entry> expired;  // 1. 创建空向量存储过期定时器
-    Entry sentry(now, reinterpret_cast<Timer*>(UINTPTR_MAX));  // 2. 创建哨兵条目
-    TimerList::iterator end = timers_.lower_bound(sentry);  // 3. 查找第一个未过期的定时器:由于哨兵条目的时间戳是 now 且 Timer 指针最大，这会找到第一个时间戳 >= now 的定时器
-    /* 下面一行代码等价于：
-    for (auto it = timers_.begin(); it != end; ++it) {
-    expired.push_back(*it);  // 将元素添加到向量末尾，自动分配内存
-    }
-    */
-    std::copy(timers_.begin(), end, back_inserter(expired));  // 4. 复制所有过期定时器
-    timers_.erase(timers_.begin(), end);  // 5. 从队列中移除已过期的定时器
+void TimerQueue::handleRead(){
+    ReadTimerFd(timerfd_);
+    Timestamp now = Timestamp::now();
+    armedTick_ = UINT64_MAX; // timerfd_是一次性设置的 已经触发
 
-    return expired;
-}
+    advance(static_cast<uint64_t>(now.microSecondsSinceEpoch() / kTickMicroSeconds), expired_);
+    // 遍历已经到点的定时器，执行对应的回调函数
+    callingExpiredTimers_ = true;
+    for(Timer* timer : expired_){
+        if(!timer->canceled()) timer->run();
+    }
+    callingExpiredTimers_ = false;
 
-void TimerQueue::reset(const std::vector<Entry>& expired, Timestamp now){
-    Timestamp nextExpire;
-    for(const Entry& it : expired){
-        // 重复任务则继续执行
-        if(it.second->repeat()){
-            auto timer = it.second;
-            timer->restart(Timestamp::now());
+    // 重复任务重新插入 其余回收
+    for(Timer* timer : expired_){
+        if(timer->repeat() && !timer->canceled()){
+            timer->restart(now);
             insert(timer);
         }else{
-            delete it.second;
+            freeTimer(timer);
         }
-        // 如果重新插入了定时器，需要继续重置timerfd
-        if(!timers_.empty()) resetTimerfd(timerfd_,(timers_.begin()->second)->expiration());
     }
+    expired_.clear();
+    rearm();
 }
 
-void TimerQueue::handleRead(){
-    Timestamp now = Timestamp::now();
-    ReadTimerFd(timerfd_);
+uint64_t TimerQueue::toTick(Timestamp when){
+    // 向上取整 保证定时器不会提前触发
+    int64_t us = when.microSecondsSinceEpoch();
+    if(us < 0) us = 0;
+    return static_cast<uint64_t>((us + kTickMicroSeconds - 1) / kTickMicroSeconds);
+}
 
-    std::vector<Entry> expired = getExpired(now);
-    // 遍历已经到点的定时器，执行对应的回调函数
-    callingExpiredTimers_ = true;
-    for(const Entry& it : expired){
-        it.second->run();
+uint64_t TimerQueue::cascadeTick(int level, int index) const{
+    const int shift = levelShift(level);
+    const uint64_t base = currentTick_ >> shift;
+    uint64_t k = (static_cast<uint64_t>(index) - base) & (kLevelSize - 1);
+    // 与当前指针相同的槽位: 恰好在边界上则本tick就会cascade 否则要再转一整圈
+    if(k == 0 && (currentTick_ & ((1ULL << shift) - 1)) != 0) k = kLevelSize;
+    return (base + k) << shift;
+}
+
+uint64_t TimerQueue::insert(Timer* timer){
+    uint64_t expire = toTick(timer->expiration());
+    // 已经过期的定时器放到下一个要处理的槽位
+    if(expire < currentTick_) expire = currentTick_;
+    const uint64_t delta = expire - currentTick_;
+    ++count_;
+
+    if(delta < static_cast<uint64_t>(kRootSize)){
+        timer->linkBefore(&root_[expire & (kRootSize - 1)]);
+        return expire;
     }
-    callingExpiredTimers_ = false;
-    
-    // 重新设置这些定时器
-    reset(expired, now);
-}
-
-bool TimerQueue::insert(Timer* timer){
-    bool earliestChanged = false;
-    Timestamp when = timer->expiration();
-    TimerList::iterator it = timers_.begin();
-    // 说明最早的定时器已经被替换了
-    if(it == timers_.end() || when < it->first) earliestChanged = true;
-    
-    // 定时器管理红黑树插入此新定时器
-    timers_.insert(Entry(when,timer));
-    return earliestChanged;
-}
\ No newline at end of file
+    // 找到能容纳delta的最低层 超出总跨度的定时器放在最高层 cascade时会再绕一圈
+    int level = 1;
+    while(level < kLevels && delta >= (1ULL << levelShift(level + 1))) ++level;
+    const int index = static_cast<int>((expire >> levelShift(level)) & (kLevelSize - 1));
+    timer->linkBefore(&levels_[level - 1][index]);
+    return cascadeTick(level, index);
+}
+
+int TimerQueue::cascade(int level, int index){
+    TimerLink& slot = levels_[level - 1][index];
+    if(!slot.linked()) return index;
+    // 先把整个槽位摘到临时链表上 避免最高层的定时器被重新放回同一个槽位
+    TimerLink pending;
+    pending.next = slot.next;
+    pending.prev = slot.prev;
+    pending.next->prev = &pending;
+    pending.prev->next = &pending;
+    slot.next = slot.prev = &slot;
+
+    while(pending.linked()){
+        Timer* timer = static_cast<Timer*>(pending.next);
+        timer->unlink();
+        --count_;
+        insert(timer);
+    }
+    return index;
+}
+
+void TimerQueue::advance(uint64_t tick, std::vector<Timer*>& expired){
+    if(tick < currentTick_) return;
+    // 跳过中间没有任何事情要做的tick
+    uint64_t next = nextWakeTick();
+    if(next > tick){
+        currentTick_ = tick + 1;
+        return;
+    }
+    currentTick_ = next;
+
+    while(currentTick_ <= tick && count_ > 0){
+        const int index = static_cast<int>(currentTick_ & (kRootSize - 1));
+        // 第0层转完一圈 逐层把高层的槽位cascade下来 直到某层指针没有回绕
+        if(index == 0){
+            for(int level = 1; level <= kLevels; ++level){
+                int slot = static_cast<int>((currentTick_ >> levelShift(level)) & (kLevelSize - 1));
+                if(cascade(level, slot) != 0) break;
+            }
+        }
+        TimerLink& slot = root_[index];
+        while(slot.linked()){
+            Timer* timer = static_cast<Timer*>(slot.next);
+            timer->unlink();
+            --count_;
+            expired.push_back(timer);
+        }
+        ++currentTick_;
+    }
+    if(currentTick_ <= tick) currentTick_ = tick + 1;
+}
+
+uint64_t TimerQueue::nextWakeTick() const{
+    if(count_ == 0) return UINT64_MAX;
+    uint64_t next = UINT64_MAX;
+    // 第0层: 当前窗口内最近的非空槽位
+    for(int i = 0; i < kRootSize; ++i){
+        uint64_t tick = currentTick_ + i;
+        if(root_[tick & (kRootSize - 1)].linked()){
+            next = tick;
+            break;
+        }
+    }
+    // 高层: 非空槽位被cascade的时刻
+    for(int level = 1; level <= kLevels; ++level){
+        for(int index = 0; index < kLevelSize; ++index){
+            if(levels_[level - 1][index].linked()) next = std::min(next, cascadeTick(level, index));
+        }
+    }
+    return next;
+}
+
+void TimerQueue::rearm(){
+    uint64_t next = nextWakeTick();
+    if(next == armedTick_) return;
+    armedTick_ = next;
+    if(next == UINT64_MAX){
+        // 没有定时器了 停止timerfd_
+        struct itimerspec newValue;
+        memset(&newValue, '\0',sizeof(newValue));
+        if(::timerfd_settime(timerfd_,0,&newValue,nullptr)) LOG_ERROR << "timefd_settime faield()";
+        return;
+    }
+    resetTimerfd(timerfd_, Timestamp(static_cast<int64_t>(next) * kTickMicroSeconds));
+}
+
+Timer* TimerQueue::newTimer(TimerCallback cb,Timestamp when,double interval){
+    // 回收池只在loop线程中访问 其他线程添加定时器时直接new
+    if(loop_->isInLoopThread() && !freeTimers_.empty()){
+        Timer* timer = freeTimers_.back();
+        freeTimers_.pop_back();
+        timer->reset(std::move(cb),when,interval);
+        return timer;
+    }
+    return new Timer(std::move(cb),when,interval);
+}
+
+void TimerQueue::freeTimer(Timer* timer){
+    // Timer在TimerQueue析构前不会真正释放 这样过期的TimerId也能安全地校验序号
+    timer->release();
+    freeTimers_.push_back(timer);
+}
@@ -0,0 +1,81 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "ZeroCopyHolder.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+ZeroCopyHolder::ZeroCopyHolder(EventLoop* loop)
+    : loop_(loop)
+    , polling_(false)
+{
+}
+
+ZeroCopyHolder::~ZeroCopyHolder(){
+    if(polling_) loop_->cancel(pollTimer_);
+    for(Entry& entry : entries_) abortEntry(entry);
+}
+
+void ZeroCopyHolder::adopt(int fd, OutputQueue::PinnedList&& pinned){
+    if(pinned.empty()) return;
+    Entry entry;
+    entry.fd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    entry.pinned = std::move(pinned);
+    entry.deadline = addTime(Timestamp::now(), kMaxHoldSeconds);
+    if(entry.fd < 0){
+        // 拿不到错误队列 只能让调用者关闭fd时直接复位连接
+        LOG_ERROR<<"ZeroCopyHolder::adopt dup fd="<<fd<<" failed, resetting the connection";
+        struct linger lg = {1, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+        return;
+    }
+    // 原fd关闭后dup的fd还引用着socket 先发FIN 保持关闭连接的时机
+    ::shutdown(entry.fd, SHUT_WR);
+    entries_.push_back(std::move(entry));
+    if(!polling_){
+        polling_ = true;
+        pollTimer_ = loop_->runAfter(kPollInterval, std::bind(&ZeroCopyHolder::poll, this));
+    }
+}
+
+size_t ZeroCopyHolder::pinnedBytes() const {
+    size_t bytes = 0;
+    for(const Entry& entry : entries_){
+        for(const auto& pinned : entry.pinned) bytes += pinned.second.size();
+    }
+    return bytes;
+}
+
+void ZeroCopyHolder::poll(){
+    polling_ = false;
+    Timestamp now = Timestamp::now();
+    uint64_t copied = 0;
+    for(size_t i = 0; i < entries_.size();){
+        Entry& entry = entries_[i];
+        OutputQueue::reapZeroCopy(entry.fd, entry.pinned, &copied);
+        if(!entry.pinned.empty() && entry.deadline < now){
+            LOG_WARN<<"ZeroCopyHolder: "<<entry.pinned.size()<<" zero-copy sends not completed in "<<kMaxHoldSeconds<<"s, resetting fd="<<entry.fd;
+            abortEntry(entry);
+        }else if(entry.pinned.empty()){
+            ::close(entry.fd);
+        }else{
+            ++i;
+            continue;
+        }
+        entries_[i] = std::move(entries_.back());
+        entries_.pop_back();
+    }
+    if(!entries_.empty()){
+        polling_ = true;
+        pollTimer_ = loop_->runAfter(kPollInterval, std::bind(&ZeroCopyHolder::poll, this));
+    }
+}
+
+void ZeroCopyHolder::abortEntry(Entry& entry){
+    // SO_LINGER{1,0}的close直接复位 内核在close中清空发送队列 之后才释放Slice
+    struct linger lg = {1, 0};
+    ::setsockopt(entry.fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+    ::close(entry.fd);
+    entry.pinned.clear();
+}
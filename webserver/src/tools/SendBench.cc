@@ -0,0 +1,160 @@
+/**
+ * 大块数据的发送测试 比较普通write和MSG_ZEROCOPY
+ * 用法: send_bench [-n 块数] [-s 每块字节数] [-z 零拷贝阈值] [-m plain|zerocopy|both] [-p 端口] [-x]
+ * 服务端在一条subloop连接上按引用send -n个同一块内存的Slice 然后shutdown, 客户端读到EOF为止
+ * 输出从连接建立到关闭的时间、吞吐和服务端loop线程的CPU时间
+ *   -x: 不启动内置的客户端 等外部客户端连接 如 nc <host> <port> > /dev/null
+ *       回环地址上内核总是退回拷贝(SO_EE_CODE_ZEROCOPY_COPIED) 零拷贝的收益要在真实网卡上用-x测
+ * 结果写到标准错误
+ **/
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "InetAddress.h"
+#include "Logger.h"
+#include "TcpServer.h"
+
+namespace
+{
+    struct Options{
+        int count = 2000;
+        size_t size = 1024 * 1024;
+        size_t threshold = 64 * 1024;
+        std::string mode = "both";
+        uint16_t port = 18480;
+        bool external = false;
+    };
+
+    struct Result{
+        double seconds = 0;
+        double serverCpu = 0; // 秒
+        size_t received = 0;  // 内置客户端读到的字节数
+    };
+
+    double threadCpuSeconds(){
+        struct timespec ts;
+        ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return static_cast<double>(ts.tv_sec) + ts.tv_nsec / 1e9;
+    }
+
+    double nowSeconds(){
+        struct timespec ts;
+        ::clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<double>(ts.tv_sec) + ts.tv_nsec / 1e9;
+    }
+
+    // 连接本机的服务端并读到EOF 返回读到的字节数
+    size_t drain(uint16_t port){
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr;
+        ::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        size_t received = 0;
+        if(::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0){
+            static char buf[256 * 1024];
+            ssize_t n;
+            while((n = ::read(fd, buf, sizeof(buf))) > 0) received += static_cast<size_t>(n);
+        }
+        ::close(fd);
+        return received;
+    }
+
+    // threshold为0时走普通的writev
+    Result runOnce(const Options& options, size_t threshold){
+        std::shared_ptr<char> block(new char[options.size], std::default_delete<char[]>());
+        ::memset(block.get(), 'x', options.size);
+
+        EventLoopThread serverThread;
+        EventLoop* loop = serverThread.startLoop();
+        std::unique_ptr<TcpServer> server;
+        std::promise<Result> done;
+        double startTime = 0;
+        double startCpu = 0;
+        std::promise<void> created;
+        loop->runInLoop([&](){
+            server.reset(new TcpServer(loop, InetAddress(options.port), "SendBench"));
+            if(threshold > 0) server->setZeroCopyThreshold(threshold);
+            server->setConnectionCallback([&](const TcpConnectionPtr& conn){
+                if(conn->connected()){
+                    startTime = nowSeconds();
+                    startCpu = threadCpuSeconds();
+                    for(int i = 0; i < options.count; ++i) conn->send(Slice(block, block.get(), options.size));
+                    conn->shutdown();
+                }else{
+                    Result result;
+                    result.seconds = nowSeconds() - startTime;
+                    result.serverCpu = threadCpuSeconds() - startCpu;
+                    done.set_value(result);
+                }
+            });
+            server->setMessageCallback([](const TcpConnectionPtr&, Buffer* buf, Timestamp){buf->retrieveAll();});
+            server->start();
+            created.set_value();
+        });
+        created.get_future().wait();
+
+        std::future<size_t> received;
+        if(!options.external) received = std::async(std::launch::async, drain, options.port);
+        else fprintf(stderr, "waiting for a client on port %u\n", options.port);
+        Result result = done.get_future().get();
+        if(!options.external) result.received = received.get();
+
+        std::promise<void> destroyed;
+        loop->runInLoop([&](){
+            server.reset();
+            destroyed.set_value();
+        });
+        destroyed.get_future().wait();
+        return result;
+    }
+
+    void report(const char* name, const Options& options, const Result& result){
+        const double bytes = static_cast<double>(options.count) * options.size;
+        fprintf(stderr, "%-9s %d x %zu bytes: %.3fs  %.1f MB/s  server cpu %.3fs", name, options.count, options.size,
+            result.seconds, bytes / result.seconds / (1024 * 1024), result.serverCpu);
+        if(!options.external) fprintf(stderr, "  received %zu", result.received);
+        fprintf(stderr, "\n");
+    }
+}
+
+int main(int argc, char* argv[]){
+    Options options;
+    int opt;
+    while((opt = ::getopt(argc, argv, "n:s:z:m:p:xh")) != -1){
+        switch(opt){
+        case 'n': options.count = std::max(1, atoi(optarg)); break;
+        case 's': options.size = std::max(1L, atol(optarg)); break;
+        case 'z': options.threshold = std::max(1L, atol(optarg)); break;
+        case 'm': options.mode = optarg; break;
+        case 'p': options.port = static_cast<uint16_t>(atoi(optarg)); break;
+        case 'x': options.external = true; break;
+        default:
+            fprintf(stderr, "usage: %s [-n blocks] [-s block bytes] [-z zero-copy threshold] [-m plain|zerocopy|both] [-p port] [-x]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if(options.mode != "plain" && options.mode != "zerocopy" && options.mode != "both"){
+        fprintf(stderr, "unknown mode %s\n", options.mode.c_str());
+        return 1;
+    }
+    Logger::setLogLevel(Logger::WARN);
+    if(options.mode != "zerocopy") report("plain", options, runOnce(options, 0));
+    if(options.mode != "plain") report("zerocopy", options, runOnce(options, options.threshold));
+    return 0;
+}
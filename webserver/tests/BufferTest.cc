@@ -0,0 +1,71 @@
+/**
+ * Buffer的存储分级与上限:
+ * 1. 默认大小的Buffer和64KB的数据各占一个同级的块 不会因为预留区升一级
+ * 2. 读空时默认保留初始大小的块 setMaxIdleCapacity(0)时全部归还
+ * 3. setMaxSize之后readFd最多积攒maxSize字节 满了返回ENOBUFS 取走数据后可以继续读
+ **/
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string>
+
+#include "Buffer.h"
+#include "BufferPool.h"
+
+namespace
+{
+    int failures = 0;
+
+    void expect(bool ok, const char* what, size_t value){
+        if(!ok){
+            fprintf(stderr, "%s: got %zu\n", what, value);
+            ++failures;
+        }
+    }
+}
+
+int main(){
+    const std::string small(100, 'x');
+    const std::string large(64 * 1024, 'y');
+    {
+        Buffer buffer;
+        buffer.append(small.data(), small.size());
+        const size_t initial = BufferPool::kMinChunkSize + BufferPool::kChunkHeadroom;
+        expect(buffer.capacity() == initial, "default capacity", buffer.capacity());
+        buffer.retrieveAll();
+        expect(buffer.capacity() == initial, "idle capacity kept", buffer.capacity());
+
+        buffer.append(large.data(), large.size());
+        const size_t grown = 64 * 1024 + BufferPool::kChunkHeadroom;
+        expect(buffer.capacity() == grown, "64KB capacity", buffer.capacity());
+        buffer.retrieveAll();
+        expect(buffer.capacity() == 0, "grown capacity released", buffer.capacity());
+    }
+    {
+        Buffer buffer;
+        buffer.setMaxIdleCapacity(0);
+        buffer.append(small.data(), small.size());
+        buffer.retrieveAll();
+        expect(buffer.capacity() == 0, "release on drain", buffer.capacity());
+    }
+    {
+        int fds[2];
+        if(::pipe(fds) < 0) return 1;
+        const std::string data(10000, 'z');
+        if(::write(fds[1], data.data(), data.size()) != static_cast<ssize_t>(data.size())) return 1;
+        Buffer buffer;
+        buffer.setMaxSize(4096);
+        int savedErrno = 0;
+        ssize_t n = buffer.readFd(fds[0], &savedErrno);
+        expect(n == 4096 && buffer.full(), "read up to max size", static_cast<size_t>(n));
+        n = buffer.readFd(fds[0], &savedErrno);
+        expect(n < 0 && savedErrno == ENOBUFS, "read when full", static_cast<size_t>(savedErrno));
+        buffer.retrieve(1000);
+        n = buffer.readFd(fds[0], &savedErrno);
+        expect(n == 1000 && buffer.readableBytes() == 4096, "read after retrieve", static_cast<size_t>(n));
+        ::close(fds[0]);
+        ::close(fds[1]);
+    }
+    if(failures == 0) printf("BufferTest passed\n");
+    return failures == 0 ? 0 : 1;
+}
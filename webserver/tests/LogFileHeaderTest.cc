@@ -0,0 +1,69 @@
+/**
+ * LogFile的文件头:
+ * 构造时打开的第一个文件在setFileHeader之前就已经存在 设置文件头时要立即补写
+ * 否则启动前注册的LOG_BIN调用点在第一个文件里没有定义 解码时成了未知调用点
+ **/
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "BinaryLog.h"
+#include "LogFile.h"
+#include "Logger.h"
+
+namespace
+{
+    void discardOutput(const char*, int){}
+
+    // 读取目录中唯一的日志文件
+    std::string readLogFile(const std::string& dir, std::string* path){
+        std::string content;
+        DIR* d = ::opendir(dir.c_str());
+        if(d == nullptr) return content;
+        while(struct dirent* entry = ::readdir(d)){
+            if(entry->d_name[0] == '.') continue;
+            *path = dir + "/" + entry->d_name;
+            std::ifstream in(path->c_str(), std::ios::binary);
+            std::ostringstream ss;
+            ss << in.rdbuf();
+            content = ss.str();
+        }
+        ::closedir(d);
+        return content;
+    }
+}
+
+int main(){
+    char dir[] = "/tmp/LogFileHeaderTestXXXXXX";
+    if(::mkdtemp(dir) == nullptr) return 1;
+
+    // 后端启动前注册的调用点 定义记录只输出到了此时的output
+    Logger::setOutput(discardOutput);
+    LOG_BIN(INFO, "header test %d", 1);
+    const std::string dictionary = BinaryLog::dictionary();
+
+    {
+        LogFile file(std::string(dir) + "/header", 1024 * 1024);
+        file.setFileHeader(BinaryLog::dictionary);
+        file.flush();
+    }
+
+    int failures = 0;
+    std::string path;
+    const std::string content = readLogFile(dir, &path);
+    if(dictionary.empty() || content.compare(0, dictionary.size(), dictionary) != 0 ||
+       !BinaryLog::isSiteRecord(content.data(), static_cast<int>(content.size()))){
+        fprintf(stderr, "first log file does not start with the dictionary: %zu bytes, dictionary %zu bytes\n",
+                content.size(), dictionary.size());
+        ++failures;
+    }
+    if(!path.empty()) ::unlink(path.c_str());
+    ::rmdir(dir);
+    if(failures == 0) printf("LogFileHeaderTest passed\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,51 @@
+/**
+ * kHashByPeer: 同一个对端地址总是选到同一个loop,
+ * 同一个网段(10.0.0.0/16)内的客户端要大致均匀地分到各个loop上 loop数是2的幂和不是2的幂都要成立
+ **/
+#include <stdio.h>
+#include <map>
+#include <string>
+
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "InetAddress.h"
+
+namespace
+{
+    const int kClients = 4096;
+
+    int check(EventLoop* baseLoop, int numThreads){
+        EventLoopThreadPool pool(baseLoop, "PeerHashTest");
+        pool.setThreadNum(numThreads);
+        pool.setSelectPolicy(EventLoopThreadPool::kHashByPeer);
+        pool.start();
+        std::map<EventLoop*, int> counts;
+        int failures = 0;
+        for(int i = 0; i < kClients; ++i){
+            InetAddress peer(40000, "10.0." + std::to_string(i / 256) + "." + std::to_string(i % 256));
+            EventLoop* loop = pool.getNextLoop(peer);
+            if(pool.getNextLoop(peer) != loop) ++failures;
+            ++counts[loop];
+        }
+        if(failures > 0) fprintf(stderr, "%d threads: %d peers moved between loops\n", numThreads, failures);
+        // 每个loop至少分到平均值的一半
+        const int expected = kClients / numThreads;
+        if(static_cast<int>(counts.size()) != numThreads) ++failures;
+        for(auto& count : counts){
+            if(count.second < expected / 2) ++failures;
+        }
+        if(failures > 0){
+            fprintf(stderr, "%d threads: %zu loops used:", numThreads, counts.size());
+            for(auto& count : counts) fprintf(stderr, " %d", count.second);
+            fprintf(stderr, "\n");
+        }
+        return failures;
+    }
+}
+
+int main(){
+    EventLoop baseLoop;
+    int failures = check(&baseLoop, 4) + check(&baseLoop, 3);
+    if(failures == 0) printf("PeerHashTest passed\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+/**
+ * sendSplice的源是同一个loop上另一条TcpConnection的socket:
+ * 1. 源连接stopRead后 数据经splice原样转发到目标连接, 源暂时没有数据时借用源连接的Channel等待
+ * 2. 转发途中源的对端关闭 splice以失败结束 源连接照常关闭 进程不会因为重复注册fd而退出
+ * 3. 等待源可读时源连接被服务端关闭 splice以失败结束 目标连接继续发送后面排队的数据
+ **/
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "TcpServer.h"
+
+namespace
+{
+    const uint16_t kPort = 18473;
+    const size_t kBytes = 1024 * 1024;
+
+    int connectServer(){
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr;
+        ::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(kPort);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if(::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0){
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    char patternAt(size_t i){return static_cast<char>('a' + i % 23);}
+
+    // 分几次写入 中间停顿让目标连接等待源可读
+    bool writeSource(int fd, size_t bytes){
+        std::string chunk;
+        for(size_t sent = 0; sent < bytes;){
+            const size_t n = std::min<size_t>(64 * 1024, bytes - sent);
+            chunk.resize(n);
+            for(size_t i = 0; i < n; ++i) chunk[i] = patternAt(sent + i);
+            for(size_t off = 0; off < n;){
+                ssize_t w = ::write(fd, chunk.data() + off, n - off);
+                if(w <= 0) return false;
+                off += static_cast<size_t>(w);
+            }
+            sent += n;
+            ::usleep(5000);
+        }
+        return true;
+    }
+
+    // 返回读到的字节数 内容不符时返回-1
+    long readSink(int fd, size_t bytes){
+        char buf[65536];
+        size_t got = 0;
+        while(got < bytes){
+            ssize_t n = ::read(fd, buf, sizeof(buf));
+            if(n <= 0) break;
+            for(ssize_t i = 0; i < n; ++i){
+                if(buf[i] != patternAt(got + i)) return -1;
+            }
+            got += static_cast<size_t>(n);
+        }
+        return static_cast<long>(got);
+    }
+
+    struct Scenario{
+        TcpConnectionPtr source;
+        std::atomic<int> result{-1}; // splice完成回调的结果 -1表示还没有回调
+        std::atomic<int> closed{0};
+        std::atomic<bool> closeSourceWhileWaiting{false};
+    };
+}
+
+int main(){
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "SpliceSourceTest", TcpServer::kReusePort);
+    Scenario scenario;
+    server.setConnectionCallback([&scenario](const TcpConnectionPtr& conn){
+        if(!conn->connected()){
+            ++scenario.closed;
+            if(conn == scenario.source) scenario.source.reset();
+            return;
+        }
+        if(!scenario.source){
+            // 第一条连接是源 数据留给splice读
+            scenario.source = conn;
+            conn->stopRead();
+        }else{
+            TcpConnectionPtr source = scenario.source;
+            conn->sendSplice(source->fd(), kBytes, [&scenario, source](const TcpConnectionPtr&, bool ok){
+                scenario.result = ok ? 1 : 0;
+                // 恢复读取 源连接才能发现对端关闭
+                source->startRead();
+            });
+            if(scenario.closeSourceWhileWaiting){
+                conn->send(std::string("tail"));
+                conn->getLoop()->runAfter(0.1, [source](){source->forceClose();});
+            }
+        }
+    });
+    server.start();
+
+    int failures = 0;
+    std::thread client([&](){
+        // 1. 完整转发
+        int src = connectServer();
+        ::usleep(50 * 1000);
+        int sink = connectServer();
+        if(src < 0 || sink < 0){
+            fprintf(stderr, "connect failed\n");
+            ++failures;
+        }else{
+            std::thread writer([src](){writeSource(src, kBytes);});
+            long got = readSink(sink, kBytes);
+            writer.join();
+            for(int i = 0; i < 200 && scenario.result < 0; ++i) ::usleep(10000);
+            if(got != static_cast<long>(kBytes) || scenario.result != 1){
+                fprintf(stderr, "full transfer: got %ld of %zu bytes, splice result %d\n", got, kBytes, scenario.result.load());
+                ++failures;
+            }
+            ::close(src);
+            ::close(sink);
+        }
+        for(int i = 0; i < 200 && scenario.closed < 2; ++i) ::usleep(10000);
+
+        // 2. 源在转发途中关闭
+        scenario.result = -1;
+        src = connectServer();
+        ::usleep(50 * 1000);
+        sink = connectServer();
+        if(src < 0 || sink < 0){
+            fprintf(stderr, "connect failed\n");
+            ++failures;
+        }else{
+            writeSource(src, kBytes / 4);
+            ::usleep(50 * 1000);
+            ::close(src);
+            long got = readSink(sink, kBytes / 4);
+            for(int i = 0; i < 200 && scenario.result < 0; ++i) ::usleep(10000);
+            if(got != static_cast<long>(kBytes / 4) || scenario.result != 0){
+                fprintf(stderr, "aborted transfer: got %ld of %zu bytes, splice result %d\n", got, kBytes / 4, scenario.result.load());
+                ++failures;
+            }
+            ::close(sink);
+        }
+        for(int i = 0; i < 200 && scenario.closed < 4; ++i) ::usleep(10000);
+
+        // 3. 源连接在等待期间被关闭
+        scenario.result = -1;
+        scenario.closeSourceWhileWaiting = true;
+        src = connectServer();
+        ::usleep(50 * 1000);
+        sink = connectServer();
+        if(src < 0 || sink < 0){
+            fprintf(stderr, "connect failed\n");
+            ++failures;
+        }else{
+            char buf[16];
+            ssize_t n = ::read(sink, buf, sizeof(buf));
+            for(int i = 0; i < 200 && scenario.result < 0; ++i) ::usleep(10000);
+            if(n != 4 || ::memcmp(buf, "tail", 4) != 0 || scenario.result != 0){
+                fprintf(stderr, "closed source: read %zd bytes, splice result %d\n", n, scenario.result.load());
+                ++failures;
+            }
+            ::close(src);
+            ::close(sink);
+        }
+        for(int i = 0; i < 200 && scenario.closed < 6; ++i) ::usleep(10000);
+        loop.quit();
+    });
+    loop.loop();
+    client.join();
+    if(failures == 0) printf("SpliceSourceTest passed\n");
+    return failures == 0 ? 0 : 1;
+}
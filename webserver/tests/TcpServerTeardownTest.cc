@@ -0,0 +1,96 @@
+/**
+ * kReusePortPerLoop模式下 客户端持续建立连接的同时析构TcpServer:
+ * subloop中的Acceptor和连接要在析构返回前清理干净, 之后不能再有回调访问已经析构的TcpServer
+ **/
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "InetAddress.h"
+#include "TcpServer.h"
+
+namespace
+{
+    const uint16_t kPort = 18474;
+    const int kRounds = 20;
+
+    void connectLoop(std::atomic<bool>* stop){
+        sockaddr_in addr;
+        ::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(kPort);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        while(!*stop){
+            int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+            if(::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) ::write(fd, "x", 1);
+            ::close(fd);
+        }
+    }
+}
+
+int main(){
+    EventLoopThread baseThread;
+    EventLoop* baseLoop = baseThread.startLoop();
+    std::atomic<bool> stop(false);
+    std::vector<std::thread> clients;
+    for(int i = 0; i < 2; ++i) clients.emplace_back(connectLoop, &stop);
+
+    std::atomic<int> connections(0);
+    // server.reset()返回后置位 之后任何回调都说明析构没有等subloop清理完
+    std::atomic<bool> tornDown(false);
+    std::atomic<int> lateCallbacks(0);
+    for(int round = 0; round < kRounds; ++round){
+        tornDown = false;
+        std::unique_ptr<TcpServer> server;
+        // TcpServer要在baseloop线程中创建和析构
+        std::promise<void> created;
+        baseLoop->runInLoop([&](){
+            server.reset(new TcpServer(baseLoop, InetAddress(kPort), "TeardownTest", TcpServer::kReusePortPerLoop));
+            server->setThreadNum(2);
+            server->setConnectionCallback([&](const TcpConnectionPtr& conn){
+                if(tornDown) ++lateCallbacks;
+                if(conn->connected()) ++connections;
+            });
+            server->setMessageCallback([&](const TcpConnectionPtr&, Buffer* buf, Timestamp){
+                if(tornDown) ++lateCallbacks;
+                buf->retrieveAll();
+            });
+            server->start();
+            created.set_value();
+        });
+        created.get_future().wait();
+        ::usleep(20 * 1000);
+        std::promise<void> destroyed;
+        baseLoop->runInLoop([&](){
+            server.reset();
+            tornDown = true;
+            destroyed.set_value();
+        });
+        destroyed.get_future().wait();
+        ::usleep(5 * 1000); // 给残留的回调留出触发的时间
+    }
+    stop = true;
+    for(auto& client : clients) client.join();
+
+    int failures = 0;
+    if(connections == 0){
+        fprintf(stderr, "no connection was accepted\n");
+        ++failures;
+    }
+    if(lateCallbacks != 0){
+        fprintf(stderr, "%d callbacks fired after the server was destroyed\n", lateCallbacks.load());
+        ++failures;
+    }
+    if(failures == 0) printf("TcpServerTeardownTest passed (%d rounds, %d connections)\n", kRounds, connections.load());
+    return failures == 0 ? 0 : 1;
+}
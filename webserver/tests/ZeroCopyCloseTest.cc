@@ -0,0 +1,135 @@
+/**
+ * 用MSG_ZEROCOPY发送的数据还在内核中时连接被forceClose:
+ * 连接销毁后这些数据由loop的ZeroCopyHolder持有 对端读完、完成通知到达之前不能释放,
+ * 释放时先把内存清零 如果提前释放 对端收到的内容就会和发送的不一致
+ **/
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <thread>
+
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "TcpServer.h"
+#include "ZeroCopyHolder.h"
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+
+namespace
+{
+    const uint16_t kPort = 18475;
+    const size_t kBytes = 8 * 1024 * 1024;
+
+    char patternAt(size_t i){return static_cast<char>('a' + i % 23);}
+
+    bool zeroCopySupported(){
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        bool ok = ::setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) == 0;
+        ::close(fd);
+        return ok;
+    }
+
+    int connectServer(){
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        // 接收缓冲小一些 服务端关闭连接时大部分数据还在它的发送队列里
+        int rcvbuf = 64 * 1024;
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        sockaddr_in addr;
+        ::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(kPort);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if(::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0){
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    // 在loop线程中读取ZeroCopyHolder持有的字节数
+    size_t heldBytes(EventLoop* loop){
+        std::promise<size_t> result;
+        loop->runInLoop([&](){result.set_value(loop->zeroCopyHolder()->pinnedBytes());});
+        return result.get_future().get();
+    }
+}
+
+int main(){
+    if(!zeroCopySupported()){
+        printf("ZeroCopyCloseTest skipped: SO_ZEROCOPY not supported\n");
+        return 0;
+    }
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "ZeroCopyCloseTest");
+    server.setZeroCopyThreshold(64 * 1024);
+    std::atomic<bool> freed(false);
+    std::atomic<bool> destroyed(false);
+    server.setConnectionCallback([&](const TcpConnectionPtr& conn){
+        if(!conn->connected()){
+            destroyed = true;
+            return;
+        }
+        char* data = new char[kBytes];
+        for(size_t i = 0; i < kBytes; ++i) data[i] = patternAt(i);
+        std::shared_ptr<char> owner(data, [&freed](char* p){
+            ::memset(p, 0, kBytes);
+            delete[] p;
+            freed = true;
+        });
+        conn->send(Slice(owner, data, kBytes));
+        conn->forceClose();
+    });
+    server.setMessageCallback([](const TcpConnectionPtr&, Buffer* buf, Timestamp){buf->retrieveAll();});
+    server.start();
+
+    int failures = 0;
+    std::thread client([&](){
+        int fd = connectServer();
+        if(fd < 0){
+            fprintf(stderr, "connect failed\n");
+            ++failures;
+            loop.quit();
+            return;
+        }
+        for(int i = 0; i < 200 && !destroyed; ++i) ::usleep(10000);
+        ::usleep(50 * 1000); // 等connectDestroyed和TcpConnection析构
+        const size_t held = heldBytes(&loop);
+        if(!destroyed || freed || held == 0){
+            fprintf(stderr, "after close: destroyed %d freed %d held %zu bytes\n", destroyed.load(), freed.load(), held);
+            ++failures;
+        }
+        // 读出的内容必须是原始数据 不能是释放时清零的内存
+        char buf[64 * 1024];
+        size_t got = 0;
+        bool intact = true;
+        ssize_t n;
+        while((n = ::read(fd, buf, sizeof(buf))) > 0){
+            for(ssize_t i = 0; i < n && intact; ++i) intact = buf[i] == patternAt(got + i);
+            got += static_cast<size_t>(n);
+        }
+        ::close(fd);
+        if(!intact || got == 0){
+            fprintf(stderr, "client read %zu bytes, intact %d\n", got, intact);
+            ++failures;
+        }
+        for(int i = 0; i < 200 && !freed; ++i) ::usleep(10000);
+        if(!freed || heldBytes(&loop) != 0){
+            fprintf(stderr, "pinned data not released after the peer read it\n");
+            ++failures;
+        }
+        loop.quit();
+    });
+    loop.loop();
+    client.join();
+    if(failures == 0) printf("ZeroCopyCloseTest passed\n");
+    return failures == 0 ? 0 : 1;
+}